@@ -0,0 +1,4014 @@
+/********************************************************************
+ Classes of the Kaon DCC toy model: event generation, moments,
+ exact expectation values, event I/O and parameter scans. Used by
+ the RunDccToyModel.C macro (interpreted, ACLiC or compiled into the
+ DccToyModel library, see CMakeLists.txt).
+ *********************************************************************
+ Written by - Ranjit Nayak & Claude A. Pruneau
+ email - ranjit.nayak@cern.ch, capruneau@gmail.com
+ */
+
+#ifndef DccToyModel_h
+#define DccToyModel_h
+
+#if !defined(__CINT__) || defined(__MAKECINT__)
+#include <TMath.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <Riostream.h>
+#include <TMinuit.h>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <TLatex.h>
+#include <TH1.h>
+#include <TF1.h>
+#include <TStyle.h>
+#include "TGraphErrors.h"
+#include <TRandom3.h>
+#include "THnSparse.h"
+#include <TCanvas.h>
+#include <TROOT.h>
+#include <TSystem.h>
+#include <TVectorD.h>
+#include <TStopwatch.h>
+#include <TH2.h>
+#include <TLegend.h>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <time.h>
+#endif
+
+using namespace std;
+
+////////////////////////////////////////////
+// Helper method to create a legend
+////////////////////////////////////////////
+inline TLegend * createLegend(double xLow, double xHigh, double yLow, double yHigh, double textSize, int nCols)
+{
+  TLegend * l = new TLegend(xLow, yLow, xHigh, yHigh,"","NBNDC");
+  l->SetLineColor(0);
+  l->SetFillColor(0);
+  l->SetTextSize(textSize);
+  l->SetNColumns(nCols);
+  return l;
+}
+
+class KaonEvent
+{
+public:
+  
+  double centrality;
+  int  k;
+  int  k0;
+  int  k0s;
+  int  kc;
+  
+  int  k_Binomial;
+  int  k0_Binomial;
+  int  k0s_Binomial;
+  int  kc_Binomial;
+  
+  int  k_DCC;
+  int  k0_DCC;
+  int  k0s_DCC;
+  int  kc_DCC;
+  
+  double k0Fraction;
+  double k0sFraction;
+  double k0Fraction_DCC;
+  double k0sFraction_DCC;
+  double k0Fraction_Binomial;
+  double k0sFraction_Binomial;
+  
+  KaonEvent()
+  {
+  cout << "-I- KaonEvent() Creating event instance." << endl;
+  }
+  
+  ~KaonEvent()
+  {}
+  
+  void print(ostream & os)
+  {
+  os << "----------------------------------------------------" << endl;
+  os << "        centrality: " << centrality << endl;
+  os << "                 k: " << k << endl;
+  os << "                k0: " << k0 << endl;
+  os << "               k0s: " << k0s << endl;
+  os << "                kc: " << kc << endl;
+  os << "        k_Binomial: " << k_Binomial << endl;
+  os << "       k0_Binomial: " << k0_Binomial  << endl;
+  os << "      k0s_Binomial: " << k0s_Binomial  << endl;
+  os << "       kc_Binomial: " << kc_Binomial  << endl;
+  os << "             k_DCC: " << k_DCC << endl;
+  os << "            k0_DCC: " << k0_DCC  << endl;
+  os << "           k0s_DCC: " << k0s_DCC  << endl;
+  os << "            kc_DCC: " << kc_DCC  << endl;
+  os << "        k0Fraction: " << k0Fraction << endl;
+  os << "       k0sFraction: " << k0sFraction << endl;
+  os << "    k0Fraction_DCC: " << k0Fraction_DCC << endl;
+  os << "   k0sFraction_DCC: " << k0sFraction_DCC << endl;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Block of events stored as one contiguous
+// column per field (structure of arrays)
+// for the batched generator and fill.
+////////////////////////////////////////////
+class KaonEventBatch
+{
+public:
+  
+  int capacity;
+  int nEvents;
+  
+  double * centrality;
+  int    * k;
+  int    * k0;
+  int    * k0s;
+  int    * kc;
+  
+  int    * k_Binomial;
+  int    * k0_Binomial;
+  int    * k0s_Binomial;
+  int    * kc_Binomial;
+  
+  int    * k_DCC;
+  int    * k0_DCC;
+  int    * k0s_DCC;
+  int    * kc_DCC;
+  
+  // neutral fraction drawn for the DCC kaons
+  double * k0Fraction_DCC;
+  
+  KaonEventBatch(int aCapacity)
+  {
+  capacity       = aCapacity;
+  nEvents        = 0;
+  centrality     = new double[capacity];
+  k              = new int[capacity];
+  k0             = new int[capacity];
+  k0s            = new int[capacity];
+  kc             = new int[capacity];
+  k_Binomial     = new int[capacity];
+  k0_Binomial    = new int[capacity];
+  k0s_Binomial   = new int[capacity];
+  kc_Binomial    = new int[capacity];
+  k_DCC          = new int[capacity];
+  k0_DCC         = new int[capacity];
+  k0s_DCC        = new int[capacity];
+  kc_DCC         = new int[capacity];
+  k0Fraction_DCC = new double[capacity];
+  }
+  
+  ~KaonEventBatch()
+  {
+  delete [] centrality;
+  delete [] k;
+  delete [] k0;
+  delete [] k0s;
+  delete [] kc;
+  delete [] k_Binomial;
+  delete [] k0_Binomial;
+  delete [] k0s_Binomial;
+  delete [] kc_Binomial;
+  delete [] k_DCC;
+  delete [] k0_DCC;
+  delete [] k0s_DCC;
+  delete [] kc_DCC;
+  delete [] k0Fraction_DCC;
+  }
+  
+  ////////////////////////////////////////////
+  // Copy event i into a KaonEvent, e.g. for
+  // printing
+  ////////////////////////////////////////////
+  void getEvent(int i, KaonEvent & event)
+  {
+  event.centrality   = centrality[i];
+  event.k            = k[i];
+  event.k0           = k0[i];
+  event.k0s          = k0s[i];
+  event.kc           = kc[i];
+  event.k_Binomial   = k_Binomial[i];
+  event.k0_Binomial  = k0_Binomial[i];
+  event.k0s_Binomial = k0s_Binomial[i];
+  event.kc_Binomial  = kc_Binomial[i];
+  event.k_DCC        = k_DCC[i];
+  event.k0_DCC       = k0_DCC[i];
+  event.k0s_DCC      = k0s_DCC[i];
+  event.kc_DCC       = kc_DCC[i];
+  event.k0Fraction           = double(event.k0)/double(event.k);
+  event.k0sFraction          = double(event.k0s)/double(event.k);
+  event.k0Fraction_DCC       = double(event.k0_DCC)/double(event.k_DCC);
+  event.k0sFraction_DCC      = double(event.k0s_DCC)/double(event.k_DCC);
+  event.k0Fraction_Binomial  = double(event.k0_Binomial)/double(event.k_Binomial);
+  event.k0sFraction_Binomial = double(event.k0s_Binomial)/double(event.k_Binomial);
+  }
+  
+};
+
+
+////////////////////////////////////////////
+// Equal-width binning with the TAxis bin
+// numbering: 0 is the underflow and
+// nBins+1 the overflow bin.
+////////////////////////////////////////////
+class KaonHistogramAxis
+{
+public:
+  
+  int    nBins;
+  double min;
+  double max;
+  // unit-width bins starting at an integer:
+  // integer values map to bins without any
+  // floating point arithmetic
+  bool   unitWidth;
+  int    iMin;
+  
+  KaonHistogramAxis(int n, double lo, double hi)
+  {
+  nBins     = n;
+  min       = lo;
+  max       = hi;
+  iMin      = int(lo);
+  unitWidth = (hi-lo == n) && (iMin == lo);
+  }
+  
+  // same expression as TAxis::FindBin
+  int findBin(double x) const
+  {
+  if (x<min) return 0;
+  if (!(x<max)) return nBins+1;
+  return 1 + int(nBins*(x-min)/(max-min));
+  }
+  
+  int findBin(int x) const
+  {
+  if (!unitWidth) return findBin(double(x));
+  int bin = x - iMin + 1;
+  if (bin<0) return 0;
+  if (bin>nBins+1) return nBins+1;
+  return bin;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Dense integer-count 1D histogram. Keeps the
+// TH1 statistics sums so that toTH1D() gives
+// the same histogram as filling a TH1D with
+// unit weights.
+////////////////////////////////////////////
+class KaonHistogram1D
+{
+public:
+  
+  TString name;
+  KaonHistogramAxis axis;
+  long long * counts;
+  long long   nEntries;
+  // in-range sums, as TH1 fTsumw, fTsumwx, fTsumwx2
+  double      sumW;
+  double      sumWX;
+  double      sumWX2;
+  
+  KaonHistogram1D(const TString & aName, int nBins, double min, double max)
+  : axis(nBins, min, max)
+  {
+  name   = aName;
+  counts = new long long[nBins+2];
+  reset();
+  }
+  
+  ~KaonHistogram1D()
+  {
+  delete [] counts;
+  }
+  
+  void reset()
+  {
+  for (int k=0; k<axis.nBins+2; k++) counts[k] = 0;
+  nEntries = 0;
+  sumW     = 0.0;
+  sumWX    = 0.0;
+  sumWX2   = 0.0;
+  }
+  
+  void fill(double x)
+  {
+  int bin = axis.findBin(x);
+  counts[bin]++;
+  nEntries++;
+  if (bin>0 && bin<=axis.nBins)
+    {
+    sumW   += 1.0;
+    sumWX  += x;
+    sumWX2 += x*x;
+    }
+  }
+  
+  void fill(int x)
+  {
+  int bin = axis.findBin(x);
+  counts[bin]++;
+  nEntries++;
+  if (bin>0 && bin<=axis.nBins)
+    {
+    sumW   += 1.0;
+    sumWX  += x;
+    sumWX2 += double(x)*double(x);
+    }
+  }
+  
+  void fill(const double * x, int n)
+  {
+  for (int i=0; i<n; i++) fill(x[i]);
+  }
+  
+  ////////////////////////////////////////////
+  // Integer column: the statistics sums are
+  // exact integers, accumulated once per call
+  ////////////////////////////////////////////
+  void fill(const int * x, int n)
+  {
+  long long nIn = 0;
+  long long sx  = 0;
+  long long sx2 = 0;
+  int nBins = axis.nBins;
+  for (int i=0; i<n; i++)
+    {
+    int bin = axis.findBin(x[i]);
+    counts[bin]++;
+    long long in = (bin>0) & (bin<=nBins);
+    nIn += in;
+    sx  += in * x[i];
+    sx2 += in * x[i] * (long long) x[i];
+    }
+  nEntries += n;
+  sumW   += nIn;
+  sumWX  += sx;
+  sumWX2 += sx2;
+  }
+  
+  void add(const KaonHistogram1D & other)
+  {
+  for (int k=0; k<axis.nBins+2; k++) counts[k] += other.counts[k];
+  nEntries += other.nEntries;
+  sumW     += other.sumW;
+  sumWX    += other.sumWX;
+  sumWX2   += other.sumWX2;
+  }
+  
+  ////////////////////////////////////////////
+  // Restore the counts from an unscaled
+  // histogram made by toTH1D()
+  ////////////////////////////////////////////
+  void setFrom(const TH1 * h)
+  {
+  for (int k=0; k<axis.nBins+2; k++) counts[k] = (long long) h->GetBinContent(k);
+  double stats[4];
+  h->GetStats(stats);
+  sumW     = stats[0];
+  sumWX    = stats[2];
+  sumWX2   = stats[3];
+  nEntries = (long long) h->GetEntries();
+  }
+  
+  ////////////////////////////////////////////
+  // Unscaled ROOT copy (Sumw2 = counts)
+  ////////////////////////////////////////////
+  TH1D * toTH1D() const
+  {
+  TH1D * h = new TH1D(name, name, axis.nBins, axis.min, axis.max);
+  h->Sumw2(true);
+  for (int k=0; k<axis.nBins+2; k++)
+    {
+    h->SetBinContent(k, double(counts[k]));
+    h->GetSumw2()->SetAt(double(counts[k]), k);
+    }
+  double stats[4] = { sumW, sumW, sumWX, sumWX2 };
+  h->PutStats(stats);
+  h->SetEntries(double(nEntries));
+  return h;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Sparse integer-count 2D histogram. Each x
+// bin stores only the contiguous span of y
+// bins filled so far, which suits the
+// strongly correlated kc-k0 and kc-k0s
+// distributions. Statistics sums as TH2.
+////////////////////////////////////////////
+class KaonHistogram2D
+{
+public:
+  
+  TString name;
+  KaonHistogramAxis xAxis;
+  KaonHistogramAxis yAxis;
+  int        * rowLow;
+  int        * rowSize;
+  long long ** rowCounts;
+  long long    nEntries;
+  // in-range sums, as TH2 fTsumw ... fTsumwxy
+  double       sumW;
+  double       sumWX;
+  double       sumWX2;
+  double       sumWY;
+  double       sumWY2;
+  double       sumWXY;
+  
+  KaonHistogram2D(const TString & aName,
+                  int nBinsX, double minX, double maxX,
+                  int nBinsY, double minY, double maxY)
+  : xAxis(nBinsX, minX, maxX), yAxis(nBinsY, minY, maxY)
+  {
+  name      = aName;
+  rowLow    = new int[nBinsX+2];
+  rowSize   = new int[nBinsX+2];
+  rowCounts = new long long*[nBinsX+2];
+  for (int k=0; k<nBinsX+2; k++)
+    {
+    rowLow[k]    = 0;
+    rowSize[k]   = 0;
+    rowCounts[k] = 0;
+    }
+  reset();
+  }
+  
+  ~KaonHistogram2D()
+  {
+  for (int k=0; k<xAxis.nBins+2; k++) delete [] rowCounts[k];
+  delete [] rowCounts;
+  delete [] rowLow;
+  delete [] rowSize;
+  }
+  
+  void reset()
+  {
+  for (int k=0; k<xAxis.nBins+2; k++)
+    for (int j=0; j<rowSize[k]; j++) rowCounts[k][j] = 0;
+  nEntries = 0;
+  sumW     = 0.0;
+  sumWX    = 0.0;
+  sumWX2   = 0.0;
+  sumWY    = 0.0;
+  sumWY2   = 0.0;
+  sumWXY   = 0.0;
+  }
+  
+  ////////////////////////////////////////////
+  // Widen row binX so that it covers binY
+  ////////////////////////////////////////////
+  void extendRow(int binX, int binY)
+  {
+  int low  = rowLow[binX];
+  int size = rowSize[binX];
+  int newLow  = low;
+  int newHigh = low + size;
+  if (size==0)
+    {
+    newLow  = binY;
+    newHigh = binY + 1;
+    }
+  else if (binY<low)
+    {
+    newLow = binY;
+    }
+  else
+    {
+    newHigh = binY + 1;
+    }
+  // leave some head room on the side that grew
+  int margin = 8;
+  if (newLow<low || size==0)       newLow  -= margin;
+  if (newHigh>low+size || size==0) newHigh += margin;
+  if (newLow<0)                 newLow  = 0;
+  if (newHigh>yAxis.nBins+2)    newHigh = yAxis.nBins+2;
+  
+  long long * newCounts = new long long[newHigh-newLow];
+  for (int j=0; j<newHigh-newLow; j++) newCounts[j] = 0;
+  for (int j=0; j<size; j++) newCounts[low-newLow+j] = rowCounts[binX][j];
+  delete [] rowCounts[binX];
+  rowCounts[binX] = newCounts;
+  rowLow[binX]    = newLow;
+  rowSize[binX]   = newHigh-newLow;
+  }
+  
+  void addToBin(int binX, int binY, long long count)
+  {
+  int j = binY - rowLow[binX];
+  if (j<0 || j>=rowSize[binX])
+    {
+    extendRow(binX, binY);
+    j = binY - rowLow[binX];
+    }
+  rowCounts[binX][j] += count;
+  }
+  
+  void fill(int x, int y)
+  {
+  int binX = xAxis.findBin(x);
+  int binY = yAxis.findBin(y);
+  int j = binY - rowLow[binX];
+  if (j<0 || j>=rowSize[binX])
+    {
+    extendRow(binX, binY);
+    j = binY - rowLow[binX];
+    }
+  rowCounts[binX][j]++;
+  nEntries++;
+  if (binX>0 && binX<=xAxis.nBins && binY>0 && binY<=yAxis.nBins)
+    {
+    sumW   += 1.0;
+    sumWX  += x;
+    sumWX2 += double(x)*double(x);
+    sumWY  += y;
+    sumWY2 += double(y)*double(y);
+    sumWXY += double(x)*double(y);
+    }
+  }
+  
+  void fill(const int * x, const int * y, int n)
+  {
+  for (int i=0; i<n; i++) fill(x[i], y[i]);
+  }
+  
+  void add(const KaonHistogram2D & other)
+  {
+  for (int binX=0; binX<xAxis.nBins+2; binX++)
+    for (int j=0; j<other.rowSize[binX]; j++)
+      if (other.rowCounts[binX][j]!=0) addToBin(binX, other.rowLow[binX]+j, other.rowCounts[binX][j]);
+  nEntries += other.nEntries;
+  sumW     += other.sumW;
+  sumWX    += other.sumWX;
+  sumWX2   += other.sumWX2;
+  sumWY    += other.sumWY;
+  sumWY2   += other.sumWY2;
+  sumWXY   += other.sumWXY;
+  }
+  
+  ////////////////////////////////////////////
+  // Restore the counts from an unscaled
+  // histogram made by toTH2D()
+  ////////////////////////////////////////////
+  void setFrom(const TH2 * h)
+  {
+  reset();
+  for (int binY=0; binY<yAxis.nBins+2; binY++)
+    {
+    for (int binX=0; binX<xAxis.nBins+2; binX++)
+      {
+      long long count = (long long) h->GetBinContent(h->GetBin(binX,binY));
+      if (count!=0) addToBin(binX, binY, count);
+      }
+    }
+  double stats[7];
+  h->GetStats(stats);
+  sumW     = stats[0];
+  sumWX    = stats[2];
+  sumWX2   = stats[3];
+  sumWY    = stats[4];
+  sumWY2   = stats[5];
+  sumWXY   = stats[6];
+  nEntries = (long long) h->GetEntries();
+  }
+  
+  ////////////////////////////////////////////
+  // Unscaled ROOT copy (Sumw2 = counts)
+  ////////////////////////////////////////////
+  TH2D * toTH2D() const
+  {
+  TH2D * h = new TH2D(name, name,
+                      xAxis.nBins, xAxis.min, xAxis.max,
+                      yAxis.nBins, yAxis.min, yAxis.max);
+  h->Sumw2(true);
+  for (int binX=0; binX<xAxis.nBins+2; binX++)
+    {
+    for (int j=0; j<rowSize[binX]; j++)
+      {
+      if (rowCounts[binX][j]==0) continue;
+      int bin = h->GetBin(binX, rowLow[binX]+j);
+      h->SetBinContent(bin, double(rowCounts[binX][j]));
+      h->GetSumw2()->SetAt(double(rowCounts[binX][j]), bin);
+      }
+    }
+  double stats[7] = { sumW, sumW, sumWX, sumWX2, sumWY, sumWY2, sumWXY };
+  h->PutStats(stats);
+  h->SetEntries(double(nEntries));
+  return h;
+  }
+  
+};
+
+
+////////////////////////////////////////////
+// Species lists for KaonFactorialMoments:
+// which fields of a KaonEventBatch are
+// accumulated, and in which order. The
+// three lists share the species indices
+// below.
+////////////////////////////////////////////
+class KaonSpecies
+{
+public:
+  enum { k=0, kc=1, k0=2, k0s=3, nSpecies=4 };
+};
+
+// total kaons
+class KaonSpeciesTotal : public KaonSpecies
+{
+public:
+  static void columns(const KaonEventBatch & batch, const int ** c)
+  {
+  c[k] = batch.k;  c[kc] = batch.kc;  c[k0] = batch.k0;  c[k0s] = batch.k0s;
+  }
+};
+
+// kaons - binomial part
+class KaonSpeciesBinomial : public KaonSpecies
+{
+public:
+  static void columns(const KaonEventBatch & batch, const int ** c)
+  {
+  c[k] = batch.k_Binomial;  c[kc] = batch.kc_Binomial;  c[k0] = batch.k0_Binomial;  c[k0s] = batch.k0s_Binomial;
+  }
+};
+
+// kaons - DCC part
+class KaonSpeciesDCC : public KaonSpecies
+{
+public:
+  static void columns(const KaonEventBatch & batch, const int ** c)
+  {
+  c[k] = batch.k_DCC;  c[kc] = batch.kc_DCC;  c[k0] = batch.k0_DCC;  c[k0s] = batch.k0s_DCC;
+  }
+};
+
+////////////////////////////////////////////
+// Single pass accumulator of factorial
+// moments for the species of Species, up to
+// order MaxOrder:
+//   <n_a (n_a-1) ... (n_a-i+1)>  i<=MaxOrder
+//   <n_a^(i) n_b^(j)>  a<b, i+j<=MaxOrder
+// All loops have compile-time bounds, so the
+// per-event work is branch free. The sums are
+// kept in one flat array, sums[0] being the
+// number of events, so that accumulators can
+// be added and stored as a whole.
+////////////////////////////////////////////
+template <class Species, int MaxOrder>
+class KaonFactorialMoments
+{
+public:
+  
+  // per-batch sums are exact 64 bit integers up to 4th order
+  static_assert(MaxOrder>=2 && MaxOrder<=4, "KaonFactorialMoments: 2 <= MaxOrder <= 4");
+  
+  enum
+  {
+  nSpecies   = Species::nSpecies,
+  nPairs     = nSpecies*(nSpecies-1)/2,
+  nPairTerms = MaxOrder*(MaxOrder-1)/2,
+  nSums      = 1 + nSpecies*MaxOrder + nPairs*nPairTerms
+  };
+  
+  double sums[nSums];
+  
+  KaonFactorialMoments()
+  {
+  reset();
+  }
+  
+  void reset()
+  {
+  for (int k=0; k<nSums; k++) sums[k] = 0.0;
+  }
+  
+  void add(const KaonFactorialMoments & other)
+  {
+  for (int k=0; k<nSums; k++) sums[k] += other.sums[k];
+  }
+  
+  // copy the sums to/from v, starting at v[offset]
+  void getSums(TVectorD & v, int offset=0) const
+  {
+  for (int k=0; k<nSums; k++) v[offset+k] = sums[k];
+  }
+  
+  void setSums(const TVectorD & v, int offset=0)
+  {
+  for (int k=0; k<nSums; k++) sums[k] = v[offset+k];
+  }
+  
+  ////////////////////////////////////////////
+  // Add one event to the integer sums s, in
+  // the order of the flat layout
+  ////////////////////////////////////////////
+  static void accumulate(const int * n, long long * s)
+  {
+  long long e[nSums];
+  products(n, e);
+  for (int k=0; k<nSums; k++) s[k] += e[k];
+  }
+  
+  ////////////////////////////////////////////
+  // The factorial products of one event, in
+  // the order of the flat layout (e[0] = 1)
+  ////////////////////////////////////////////
+  static void products(const int * n, long long * e)
+  {
+  long long f[nSpecies][MaxOrder+1];
+  for (int a=0; a<nSpecies; a++)
+    {
+    f[a][0] = 1;
+    for (int i=1; i<=MaxOrder; i++) f[a][i] = f[a][i-1] * (n[a]-i+1);
+    }
+  int index = 0;
+  e[index++] = 1;
+  for (int a=0; a<nSpecies; a++)
+    for (int i=1; i<=MaxOrder; i++) e[index++] = f[a][i];
+  for (int a=0; a<nSpecies; a++)
+    for (int b=a+1; b<nSpecies; b++)
+      for (int i=1; i<MaxOrder; i++)
+        for (int j=1; i+j<=MaxOrder; j++) e[index++] = f[a][i] * f[b][j];
+  }
+  
+  ////////////////////////////////////////////
+  // Flat layout
+  ////////////////////////////////////////////
+  static int singleIndex(int a, int i)
+  {
+  return 1 + a*MaxOrder + (i-1);
+  }
+  
+  static int pairIndex(int a, int b, int i, int j)
+  {
+  int pair = a*nSpecies - a*(a+1)/2 + (b-a-1);
+  int term = 0;
+  for (int ii=1; ii<i; ii++) term += MaxOrder-ii;
+  term += j-1;
+  return 1 + nSpecies*MaxOrder + pair*nPairTerms + term;
+  }
+  
+  ////////////////////////////////////////////
+  // Moments
+  ////////////////////////////////////////////
+  double nEvents() const
+  {
+  return sums[0];
+  }
+  
+  // <n_a^(i)>, the i-th factorial moment
+  double factorial(int a, int i) const
+  {
+  return sums[singleIndex(a,i)]/sums[0];
+  }
+  
+  double mean(int a) const
+  {
+  return factorial(a,1);
+  }
+  
+  // <n_a^(i) n_b^(j)>
+  double cross(int a, int b, int i=1, int j=1) const
+  {
+  if (a>b) return cross(b, a, j, i);
+  return sums[pairIndex(a,b,i,j)]/sums[0];
+  }
+  
+  // R_ab = <n_a(n_b - delta_ab)> / <n_a><n_b> - 1
+  double R(int a, int b) const
+  {
+  if (a==b) return factorial(a,2)/mean(a)/mean(a) - 1.0;
+  return cross(a,b)/mean(a)/mean(b) - 1.0;
+  }
+  
+  double nuDyn(int a, int b) const
+  {
+  return R(a,a) + R(b,b) - 2.0*R(a,b);
+  }
+  
+  ////////////////////////////////////////////
+  // Factorial cumulant of species a, order 1
+  // to MaxOrder
+  ////////////////////////////////////////////
+  double factorialCumulant(int a, int order) const
+  {
+  if (order<1 || order>MaxOrder) return 0.0;
+  double F1 = factorial(a,1);
+  double F2 = factorial(a,2);
+  switch (order)
+    {
+    case 1: return F1;
+    case 2: return F2 - F1*F1;
+    case 3:
+      {
+      double F3 = factorial(a,3);
+      return F3 - 3.0*F2*F1 + 2.0*F1*F1*F1;
+      }
+    case 4:
+      {
+      double F3 = factorial(a,3);
+      double F4 = factorial(a,4);
+      return F4 - 4.0*F3*F1 - 3.0*F2*F2 + 12.0*F2*F1*F1 - 6.0*F1*F1*F1*F1;
+      }
+    }
+  return 0.0;
+  }
+  
+};
+
+class KaonMoments
+{
+public:
+  
+  ////////////////////////////////////////////
+  // Data members
+  ////////////////////////////////////////////
+  
+  TString baseName;
+  int    nBinsKmult;
+  double minKmult;
+  double maxKmult;
+  
+  int    nEvents;
+  
+  // factorial moment sums
+  typedef KaonFactorialMoments<KaonSpeciesTotal,    2> TotalFactorials;
+  typedef KaonFactorialMoments<KaonSpeciesBinomial, 2> BinomialFactorials;
+  typedef KaonFactorialMoments<KaonSpeciesDCC,      2> DccFactorials;
+  TotalFactorials    factorials;
+  BinomialFactorials factorials_Binomial;
+  DccFactorials      factorials_DCC;
+  
+  // moments
+  
+  // total kaons moments
+  double k_avg;
+  double kSq_avg;
+  double kF_avg;
+  double k0_avg;
+  double k0Sq_avg;
+  double k0F_avg;
+  double k0s_avg;
+  double k0sSq_avg;
+  double k0sF_avg;
+  double kc_avg;
+  double kcSq_avg;
+  double kcF_avg;
+  
+  double kck0_avg;
+  double kck0s_avg;
+  
+  // kaons moments - binomial part
+  double k_Binomial_avg;
+  double kSq_Binomial_avg;
+  double kF_Binomial_avg;
+  double k0_Binomial_avg;
+  double k0Sq_Binomial_avg;
+  double k0F_Binomial_avg;
+  double k0s_Binomial_avg;
+  double k0sSq_Binomial_avg;
+  double k0sF_Binomial_avg;
+  double kc_Binomial_avg;
+  double kcSq_Binomial_avg;
+  double kcF_Binomial_avg;
+  
+  // kaons moments - DCC part
+  double k_DCC_avg;
+  double kSq_DCC_avg;
+  double kF_DCC_avg;
+  double k0_DCC_avg;
+  double k0Sq_DCC_avg;
+  double k0F_DCC_avg;
+  double k0s_DCC_avg;
+  double k0sSq_DCC_avg;
+  double k0sF_DCC_avg;
+  double kc_DCC_avg;
+  double kcSq_DCC_avg;
+  double kcF_DCC_avg;
+  
+  // ratios and nuDyn
+  double r00;
+  double r0s0s;
+  double rchch;
+  double rch0;
+  double rch0s;
+  double nuDyn_ch0;
+  double nuDyn_ch0s;
+  
+  double r00s;
+  double nuDyn_00s;
+  double nuDyn_ch0_DCC;
+  double nuDyn_ch0s_DCC;
+  
+  // statistical errors from the subsamples
+  enum { nSubsamples = 10 };
+  TotalFactorials * subsamples;
+  double r00_err;
+  double r0s0s_err;
+  double rchch_err;
+  double rch0_err;
+  double rch0s_err;
+  double nuDyn_ch0_err;
+  double nuDyn_ch0s_err;
+  
+  TH1D * h_centrality;
+  
+  TH1D * h_k;
+  TH1D * h_kc;
+  TH1D * h_k0;
+  TH1D * h_k0s;
+  
+  TH1D * h_k_DCC;
+  TH1D * h_kc_DCC;
+  TH1D * h_k0_DCC;
+  TH1D * h_k0s_DCC;
+  
+  TH1D * h_k_Binomial;
+  TH1D * h_kc_Binomial;
+  TH1D * h_k0_Binomial;
+  TH1D * h_k0s_Binomial;
+  
+  TH2D * h_kck0;
+  TH2D * h_kck0s;
+  
+  // integer counts filled event by event; the
+  // ROOT histograms above are only created from
+  // these by makeHistograms()
+  KaonHistogram1D * counts_centrality;
+  
+  KaonHistogram1D * counts_k;
+  KaonHistogram1D * counts_kc;
+  KaonHistogram1D * counts_k0;
+  KaonHistogram1D * counts_k0s;
+  
+  KaonHistogram1D * counts_k_DCC;
+  KaonHistogram1D * counts_kc_DCC;
+  KaonHistogram1D * counts_k0_DCC;
+  KaonHistogram1D * counts_k0s_DCC;
+  
+  KaonHistogram1D * counts_k_Binomial;
+  KaonHistogram1D * counts_kc_Binomial;
+  KaonHistogram1D * counts_k0_Binomial;
+  KaonHistogram1D * counts_k0s_Binomial;
+  
+  KaonHistogram2D * counts_kck0;
+  KaonHistogram2D * counts_kck0s;
+  
+  ////////////////////////////////////////////
+  // CTOR
+  ////////////////////////////////////////////
+  KaonMoments(const TString & aName,
+              int    nBins,
+              double min,
+              double max)
+  {
+  baseName = aName;
+  nBinsKmult = nBins;
+  minKmult   = min;
+  maxKmult   = max;
+  initialize();
+  }
+  
+  ////////////////////////////////////////////
+  // DTOR
+  ////////////////////////////////////////////
+  ~KaonMoments()
+  {
+  deleteHistograms();
+  delete [] subsamples;
+  delete counts_centrality;
+  delete counts_k;
+  delete counts_kc;
+  delete counts_k0;
+  delete counts_k0s;
+  delete counts_k_DCC;
+  delete counts_kc_DCC;
+  delete counts_k0_DCC;
+  delete counts_k0s_DCC;
+  delete counts_k_Binomial;
+  delete counts_kc_Binomial;
+  delete counts_k0_Binomial;
+  delete counts_k0s_Binomial;
+  delete counts_kck0;
+  delete counts_kck0s;
+  }
+  
+  ////////////////////////////////////////////
+  // Initialize all counters and histograms
+  ////////////////////////////////////////////
+  void initialize()
+  {
+  cout << "-I- initialize() Creating KaonMoments instance." << endl;
+  nEvents   = 0;
+  
+  subsamples  = new TotalFactorials[nSubsamples];
+  resetErrors();
+  
+  factorials.reset();
+  factorials_Binomial.reset();
+  factorials_DCC.reset();
+  
+  cout << "-I- initialize() Instantiating histograms." << endl;
+
+  TH1D::SetDefaultSumw2(true);
+  
+  TString name;
+  
+  name = baseName + "centrality";
+  counts_centrality = new KaonHistogram1D(name, 1000, 0.0, 1000.0);
+  
+  name       = baseName + "k";
+  counts_k   = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name       = baseName + "kc";
+  counts_kc  = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name       = baseName + "k0";
+  counts_k0  = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name       = baseName + "k0s";
+  counts_k0s = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  
+  name           = baseName + "k_DCC";
+  counts_k_DCC   = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name           = baseName + "kc_DCC";
+  counts_kc_DCC  = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name           = baseName + "k0_DCC";
+  counts_k0_DCC  = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name           = baseName + "k0s_DCC";
+  counts_k0s_DCC = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  
+  name                = baseName + "k_Binomial";
+  counts_k_Binomial   = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name                = baseName + "kc_Binomial";
+  counts_kc_Binomial  = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name                = baseName + "k0_Binomial";
+  counts_k0_Binomial  = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  name                = baseName + "k0s_Binomial";
+  counts_k0s_Binomial = new KaonHistogram1D(name, nBinsKmult, minKmult, maxKmult);
+  
+  name = baseName + "kck0";
+  counts_kck0  = new KaonHistogram2D(name, nBinsKmult, minKmult, maxKmult, nBinsKmult, minKmult, maxKmult);
+  name = baseName + "kck0s";
+  counts_kck0s = new KaonHistogram2D(name, nBinsKmult, minKmult, maxKmult, nBinsKmult, minKmult, maxKmult);
+  
+  h_centrality   = 0;
+  h_k            = 0;
+  h_kc           = 0;
+  h_k0           = 0;
+  h_k0s          = 0;
+  h_k_DCC        = 0;
+  h_kc_DCC       = 0;
+  h_k0_DCC       = 0;
+  h_k0s_DCC      = 0;
+  h_k_Binomial   = 0;
+  h_kc_Binomial  = 0;
+  h_k0_Binomial  = 0;
+  h_k0s_Binomial = 0;
+  h_kck0         = 0;
+  h_kck0s        = 0;
+  
+  cout << "-I- initialize() Done." << endl;
+
+  }
+  
+  ////////////////////////////////////////////
+  // increment the counters and fill
+  // histograms for a whole batch of events
+  ////////////////////////////////////////////
+  void fill(const KaonEventBatch & batch)
+  {
+  fill(batch, 0, batch.nEvents);
+  }
+  
+  ////////////////////////////////////////////
+  // Events first to first+n-1 of batch
+  ////////////////////////////////////////////
+  void fill(const KaonEventBatch & batch, int first, int n)
+  {
+  // one pass over the events: the factorial
+  // products of the totals go to factorials and
+  // to the subsample of the event, those of the
+  // binomial and DCC parts to their own sums
+  enum { nSpecies = KaonSpecies::nSpecies,
+         nTotal = TotalFactorials::nSums, nBinomial = BinomialFactorials::nSums, nDcc = DccFactorials::nSums };
+  const int * c[nSpecies];
+  const int * c_Binomial[nSpecies];
+  const int * c_DCC[nSpecies];
+  KaonSpeciesTotal::columns(batch, c);
+  KaonSpeciesBinomial::columns(batch, c_Binomial);
+  KaonSpeciesDCC::columns(batch, c_DCC);
+  long long s[nTotal];
+  long long s_Binomial[nBinomial];
+  long long s_DCC[nDcc];
+  long long s_Sub[nSubsamples][nTotal];
+  for (int k=0; k<nTotal; k++) s[k] = 0;
+  for (int k=0; k<nBinomial; k++) s_Binomial[k] = 0;
+  for (int k=0; k<nDcc; k++) s_DCC[k] = 0;
+  for (int iSub=0; iSub<nSubsamples; iSub++)
+    for (int k=0; k<nTotal; k++) s_Sub[iSub][k] = 0;
+  
+  int iSub = nEvents % nSubsamples;
+  for (int i=first; i<first+n; i++)
+    {
+    int values[nSpecies];
+    long long products[nTotal];
+    for (int a=0; a<nSpecies; a++) values[a] = c[a][i];
+    TotalFactorials::products(values, products);
+    for (int k=0; k<nTotal; k++)
+      {
+      s[k]            += products[k];
+      s_Sub[iSub][k]  += products[k];
+      }
+    if (++iSub==nSubsamples) iSub = 0;
+    for (int a=0; a<nSpecies; a++) values[a] = c_Binomial[a][i];
+    BinomialFactorials::accumulate(values, s_Binomial);
+    for (int a=0; a<nSpecies; a++) values[a] = c_DCC[a][i];
+    DccFactorials::accumulate(values, s_DCC);
+    }
+  nEvents += n;
+  
+  for (int k=0; k<nTotal; k++) factorials.sums[k] += s[k];
+  for (int k=0; k<nBinomial; k++) factorials_Binomial.sums[k] += s_Binomial[k];
+  for (int k=0; k<nDcc; k++) factorials_DCC.sums[k] += s_DCC[k];
+  for (int jSub=0; jSub<nSubsamples; jSub++)
+    for (int k=0; k<nTotal; k++) subsamples[jSub].sums[k] += s_Sub[jSub][k];
+  
+  counts_centrality->fill(batch.centrality+first, n);
+  
+  counts_k  ->fill(batch.k  +first, n);
+  counts_kc ->fill(batch.kc +first, n);
+  counts_k0 ->fill(batch.k0 +first, n);
+  counts_k0s->fill(batch.k0s+first, n);
+  counts_k_DCC  ->fill(batch.k_DCC  +first, n);
+  counts_kc_DCC ->fill(batch.kc_DCC +first, n);
+  counts_k0_DCC ->fill(batch.k0_DCC +first, n);
+  counts_k0s_DCC->fill(batch.k0s_DCC+first, n);
+  counts_k_Binomial  ->fill(batch.k_Binomial  +first, n);
+  counts_kc_Binomial ->fill(batch.kc_Binomial +first, n);
+  counts_k0_Binomial ->fill(batch.k0_Binomial +first, n);
+  counts_k0s_Binomial->fill(batch.k0s_Binomial+first, n);
+  
+  counts_kck0 ->fill(batch.kc+first, batch.k0 +first, n);
+  counts_kck0s->fill(batch.kc+first, batch.k0s+first, n);
+  }
+  
+  ////////////////////////////////////////////
+  // Calculate moments
+  ////////////////////////////////////////////
+  void calculateMoments()
+  {
+  if (nEvents<2)
+    {
+    cout << "-E- calculateMoments() nEvents<2 -- Cannot calculate moments" << endl;
+    resetErrors();
+    return;
+    }
+  
+  getAverages(factorials, KaonSpecies::k,   k_avg,   kSq_avg,   kF_avg);
+  getAverages(factorials, KaonSpecies::k0,  k0_avg,  k0Sq_avg,  k0F_avg);
+  getAverages(factorials, KaonSpecies::k0s, k0s_avg, k0sSq_avg, k0sF_avg);
+  getAverages(factorials, KaonSpecies::kc,  kc_avg,  kcSq_avg,  kcF_avg);
+  
+  getAverages(factorials_Binomial, KaonSpecies::k,   k_Binomial_avg,   kSq_Binomial_avg,   kF_Binomial_avg);
+  getAverages(factorials_Binomial, KaonSpecies::k0,  k0_Binomial_avg,  k0Sq_Binomial_avg,  k0F_Binomial_avg);
+  getAverages(factorials_Binomial, KaonSpecies::k0s, k0s_Binomial_avg, k0sSq_Binomial_avg, k0sF_Binomial_avg);
+  getAverages(factorials_Binomial, KaonSpecies::kc,  kc_Binomial_avg,  kcSq_Binomial_avg,  kcF_Binomial_avg);
+  
+  getAverages(factorials_DCC, KaonSpecies::k,   k_DCC_avg,   kSq_DCC_avg,   kF_DCC_avg);
+  getAverages(factorials_DCC, KaonSpecies::k0,  k0_DCC_avg,  k0Sq_DCC_avg,  k0F_DCC_avg);
+  getAverages(factorials_DCC, KaonSpecies::k0s, k0s_DCC_avg, k0sSq_DCC_avg, k0sF_DCC_avg);
+  getAverages(factorials_DCC, KaonSpecies::kc,  kc_DCC_avg,  kcSq_DCC_avg,  kcF_DCC_avg);
+  
+  kck0_avg    = factorials.cross(KaonSpecies::kc, KaonSpecies::k0);
+  kck0s_avg   = factorials.cross(KaonSpecies::kc, KaonSpecies::k0s);
+  
+  r00   = factorials.R(KaonSpecies::k0,  KaonSpecies::k0);
+  r0s0s = factorials.R(KaonSpecies::k0s, KaonSpecies::k0s);
+  rchch = factorials.R(KaonSpecies::kc,  KaonSpecies::kc);
+  rch0  = factorials.R(KaonSpecies::kc,  KaonSpecies::k0);
+  rch0s = factorials.R(KaonSpecies::kc,  KaonSpecies::k0s);
+  nuDyn_ch0  = rchch + r00 - 2.0*rch0;
+  nuDyn_ch0s = rchch + r0s0s - 2.0*rch0s;
+  
+  r00s      = factorials.R(KaonSpecies::k0, KaonSpecies::k0s);
+  nuDyn_00s = factorials.nuDyn(KaonSpecies::k0, KaonSpecies::k0s);
+  nuDyn_ch0_DCC  = factorials_DCC.nuDyn(KaonSpecies::kc, KaonSpecies::k0);
+  nuDyn_ch0s_DCC = factorials_DCC.nuDyn(KaonSpecies::kc, KaonSpecies::k0s);
+  
+  calculateErrors();
+  }
+  
+  ////////////////////////////////////////////
+  // <n>, <n^2> and <n(n-1)> of one species
+  ////////////////////////////////////////////
+  template <class Factorials>
+  static void getAverages(const Factorials & f, int species, double & avg, double & sqAvg, double & fAvg)
+  {
+  avg   = f.factorial(species,1);
+  fAvg  = f.factorial(species,2);
+  sqAvg = fAvg + avg;
+  }
+  
+  ////////////////////////////////////////////
+  // Error of a value from its subsample
+  // values: standard deviation of the
+  // subsample values divided by
+  // sqrt(nSubsamples)
+  ////////////////////////////////////////////
+  double subsampleError(const double * values)
+  {
+  double mean = 0.0;
+  for (int iSub=0; iSub<nSubsamples; iSub++) mean += values[iSub];
+  mean /= nSubsamples;
+  double sumSq = 0.0;
+  for (int iSub=0; iSub<nSubsamples; iSub++)
+    {
+    double d = values[iSub] - mean;
+    sumSq += d*d;
+    }
+  return TMath::Sqrt(sumSq/(nSubsamples*(nSubsamples-1.0)));
+  }
+  
+  ////////////////////////////////////////////
+  // Error of R_ab over the subsamples
+  ////////////////////////////////////////////
+  double subsampleErrorR(int a, int b)
+  {
+  double values[nSubsamples];
+  for (int iSub=0; iSub<nSubsamples; iSub++) values[iSub] = subsamples[iSub].R(a,b);
+  return subsampleError(values);
+  }
+  
+  double subsampleErrorNuDyn(int a, int b)
+  {
+  double values[nSubsamples];
+  for (int iSub=0; iSub<nSubsamples; iSub++) values[iSub] = subsamples[iSub].nuDyn(a,b);
+  return subsampleError(values);
+  }
+  
+  void calculateErrors()
+  {
+  resetErrors();
+  for (int iSub=0; iSub<nSubsamples; iSub++)
+    {
+    if (subsamples[iSub].nEvents()<2)
+      {
+      cout << "-W- calculateErrors() Too few events per subsample -- errors not calculated" << endl;
+      return;
+      }
+    }
+  r00_err        = subsampleErrorR(KaonSpecies::k0,  KaonSpecies::k0);
+  r0s0s_err      = subsampleErrorR(KaonSpecies::k0s, KaonSpecies::k0s);
+  rchch_err      = subsampleErrorR(KaonSpecies::kc,  KaonSpecies::kc);
+  rch0_err       = subsampleErrorR(KaonSpecies::kc,  KaonSpecies::k0);
+  rch0s_err      = subsampleErrorR(KaonSpecies::kc,  KaonSpecies::k0s);
+  nuDyn_ch0_err  = subsampleErrorNuDyn(KaonSpecies::kc, KaonSpecies::k0);
+  nuDyn_ch0s_err = subsampleErrorNuDyn(KaonSpecies::kc, KaonSpecies::k0s);
+  }
+  
+  ////////////////////////////////////////////
+  // Errors of 0 mean unknown: printed as 0 and
+  // never pass precisionReached()
+  ////////////////////////////////////////////
+  void resetErrors()
+  {
+  r00_err        = 0.0;
+  r0s0s_err      = 0.0;
+  rchch_err      = 0.0;
+  rch0_err       = 0.0;
+  rch0s_err      = 0.0;
+  nuDyn_ch0_err  = 0.0;
+  nuDyn_ch0s_err = 0.0;
+  }
+  
+  ////////////////////////////////////////////
+  // True when both nuDyn values are known to
+  // the requested precision. A value passes
+  // if its error is below absolutePrecision
+  // or below relativePrecision*|value|; a
+  // precision <= 0 is not used.
+  ////////////////////////////////////////////
+  bool precisionReached(double relativePrecision, double absolutePrecision)
+  {
+  double values[2] = { nuDyn_ch0,     nuDyn_ch0s     };
+  double errors[2] = { nuDyn_ch0_err, nuDyn_ch0s_err };
+  for (int k=0; k<2; k++)
+    {
+    if (errors[k]<=0.0) return false;
+    bool reached = false;
+    if (absolutePrecision>0.0 && errors[k]<=absolutePrecision) reached = true;
+    if (relativePrecision>0.0 && errors[k]<=relativePrecision*TMath::Abs(values[k])) reached = true;
+    if (!reached) return false;
+    }
+  return true;
+  }
+  
+  ////////////////////////////////////////////
+  // Create the ROOT histograms from the counts
+  // and scale them to per event values
+  ////////////////////////////////////////////
+  void makeHistograms()
+  {
+  if (nEvents<1)
+    {
+    cout << "-E- makeHistograms() nEvents<1 -- Cannot scale histograms" << endl;
+    return;
+    }
+  deleteHistograms();
+  double scale = 1.0/double(nEvents);
+  
+  h_centrality   = counts_centrality->toTH1D();
+  h_k            = counts_k->toTH1D();
+  h_kc           = counts_kc->toTH1D();
+  h_k0           = counts_k0->toTH1D();
+  h_k0s          = counts_k0s->toTH1D();
+  h_k_DCC        = counts_k_DCC->toTH1D();
+  h_kc_DCC       = counts_kc_DCC->toTH1D();
+  h_k0_DCC       = counts_k0_DCC->toTH1D();
+  h_k0s_DCC      = counts_k0s_DCC->toTH1D();
+  h_k_Binomial   = counts_k_Binomial->toTH1D();
+  h_kc_Binomial  = counts_kc_Binomial->toTH1D();
+  h_k0_Binomial  = counts_k0_Binomial->toTH1D();
+  h_k0s_Binomial = counts_k0s_Binomial->toTH1D();
+  h_kck0         = counts_kck0->toTH2D();
+  h_kck0s        = counts_kck0s->toTH2D();
+  
+  h_centrality->Scale(scale);
+  
+  h_k   ->Scale(scale);
+  h_kc  ->Scale(scale);
+  h_k0  ->Scale(scale);
+  h_k0s ->Scale(scale);
+  h_k_DCC   ->Scale(scale);
+  h_kc_DCC  ->Scale(scale);
+  h_k0_DCC  ->Scale(scale);
+  h_k0s_DCC ->Scale(scale);
+  h_k_Binomial   ->Scale(scale);
+  h_kc_Binomial  ->Scale(scale);
+  h_k0_Binomial  ->Scale(scale);
+  h_k0s_Binomial ->Scale(scale);
+  h_kck0  ->Scale(scale);
+  h_kck0s ->Scale(scale);
+  }
+  
+  ////////////////////////////////////////////
+  // The 1D counts in a fixed order, for
+  // saving, loading and merging
+  ////////////////////////////////////////////
+  int getCounts1D(KaonHistogram1D ** list)
+  {
+  list[0]  = counts_centrality;
+  list[1]  = counts_k;
+  list[2]  = counts_kc;
+  list[3]  = counts_k0;
+  list[4]  = counts_k0s;
+  list[5]  = counts_k_DCC;
+  list[6]  = counts_kc_DCC;
+  list[7]  = counts_k0_DCC;
+  list[8]  = counts_k0s_DCC;
+  list[9]  = counts_k_Binomial;
+  list[10] = counts_kc_Binomial;
+  list[11] = counts_k0_Binomial;
+  list[12] = counts_k0s_Binomial;
+  return 13;
+  }
+  
+  ////////////////////////////////////////////
+  // Add the events accumulated by other (same
+  // binning and number of subsamples)
+  ////////////////////////////////////////////
+  bool add(KaonMoments & other)
+  {
+  if (other.nSubsamples!=nSubsamples || other.nBinsKmult!=nBinsKmult ||
+      other.minKmult!=minKmult || other.maxKmult!=maxKmult)
+    {
+    cout << "-E- add(...) Incompatible KaonMoments -- Not added" << endl;
+    return false;
+    }
+  nEvents += other.nEvents;
+  factorials.add(other.factorials);
+  factorials_Binomial.add(other.factorials_Binomial);
+  factorials_DCC.add(other.factorials_DCC);
+  for (int iSub=0; iSub<nSubsamples; iSub++) subsamples[iSub].add(other.subsamples[iSub]);
+  
+  KaonHistogram1D * list[13];
+  KaonHistogram1D * otherList[13];
+  int n = getCounts1D(list);
+  other.getCounts1D(otherList);
+  for (int k=0; k<n; k++) list[k]->add(*otherList[k]);
+  counts_kck0 ->add(*other.counts_kck0);
+  counts_kck0s->add(*other.counts_kck0s);
+  return true;
+  }
+  
+  ////////////////////////////////////////////
+  // Write the raw state to dir: event count,
+  // factorial moment sums (also per
+  // subsample) and unscaled histograms
+  ////////////////////////////////////////////
+  void saveState(TDirectory * dir)
+  {
+  TVectorD info(5);
+  info[0] = nEvents;
+  info[1] = nSubsamples;
+  info[2] = nBinsKmult;
+  info[3] = minKmult;
+  info[4] = maxKmult;
+  dir->WriteTObject(&info, "moments_info");
+  
+  TVectorD total(TotalFactorials::nSums);
+  TVectorD binomial(BinomialFactorials::nSums);
+  TVectorD dcc(DccFactorials::nSums);
+  TVectorD sub(nSubsamples*TotalFactorials::nSums);
+  factorials.getSums(total);
+  factorials_Binomial.getSums(binomial);
+  factorials_DCC.getSums(dcc);
+  for (int iSub=0; iSub<nSubsamples; iSub++) subsamples[iSub].getSums(sub, iSub*TotalFactorials::nSums);
+  dir->WriteTObject(&total,    "moments_factorials");
+  dir->WriteTObject(&binomial, "moments_factorials_Binomial");
+  dir->WriteTObject(&dcc,      "moments_factorials_DCC");
+  dir->WriteTObject(&sub,      "moments_subsamples");
+  
+  KaonHistogram1D * list[13];
+  int n = getCounts1D(list);
+  for (int k=0; k<n; k++)
+    {
+    TH1D * h = list[k]->toTH1D();
+    dir->WriteTObject(h);
+    delete h;
+    }
+  TH2D * h2 = counts_kck0->toTH2D();
+  dir->WriteTObject(h2);
+  delete h2;
+  h2 = counts_kck0s->toTH2D();
+  dir->WriteTObject(h2);
+  delete h2;
+  }
+  
+  ////////////////////////////////////////////
+  // Replace the state by the one saved in dir
+  ////////////////////////////////////////////
+  bool loadState(TDirectory * dir)
+  {
+  TVectorD * info = (TVectorD *) dir->Get("moments_info");
+  if (!info)
+    {
+    cout << "-E- loadState(...) No KaonMoments state in " << dir->GetName() << endl;
+    return false;
+    }
+  bool compatible = (*info)[1]==nSubsamples && (*info)[2]==nBinsKmult && (*info)[3]==minKmult && (*info)[4]==maxKmult;
+  int nEventsSaved = int((*info)[0]);
+  delete info;
+  if (!compatible)
+    {
+    cout << "-E- loadState(...) Saved binning or number of subsamples differs -- Not loaded" << endl;
+    return false;
+    }
+  
+  TVectorD * total    = (TVectorD *) dir->Get("moments_factorials");
+  TVectorD * binomial = (TVectorD *) dir->Get("moments_factorials_Binomial");
+  TVectorD * dcc      = (TVectorD *) dir->Get("moments_factorials_DCC");
+  TVectorD * sub      = (TVectorD *) dir->Get("moments_subsamples");
+  KaonHistogram1D * list[13];
+  int n = getCounts1D(list);
+  TH1 ** h = new TH1*[n];
+  for (int k=0; k<n; k++) h[k] = (TH1 *) dir->Get(list[k]->name);
+  TH2 * h_kck0Saved  = (TH2 *) dir->Get(counts_kck0->name);
+  TH2 * h_kck0sSaved = (TH2 *) dir->Get(counts_kck0s->name);
+  
+  bool complete = total && binomial && dcc && sub && h_kck0Saved && h_kck0sSaved;
+  for (int k=0; k<n; k++) complete = complete && h[k];
+  if (complete)
+    {
+    nEvents = nEventsSaved;
+    factorials.setSums(*total);
+    factorials_Binomial.setSums(*binomial);
+    factorials_DCC.setSums(*dcc);
+    for (int iSub=0; iSub<nSubsamples; iSub++) subsamples[iSub].setSums(*sub, iSub*TotalFactorials::nSums);
+    for (int k=0; k<n; k++) list[k]->setFrom(h[k]);
+    counts_kck0 ->setFrom(h_kck0Saved);
+    counts_kck0s->setFrom(h_kck0sSaved);
+    deleteHistograms();
+    }
+  else
+    {
+    cout << "-E- loadState(...) Incomplete KaonMoments state in " << dir->GetName() << " -- Not loaded" << endl;
+    }
+  delete total;
+  delete binomial;
+  delete dcc;
+  delete sub;
+  for (int k=0; k<n; k++) delete h[k];
+  delete [] h;
+  delete h_kck0Saved;
+  delete h_kck0sSaved;
+  return complete;
+  }
+  
+  void deleteHistograms()
+  {
+  delete h_centrality;   h_centrality   = 0;
+  delete h_k;            h_k            = 0;
+  delete h_kc;           h_kc           = 0;
+  delete h_k0;           h_k0           = 0;
+  delete h_k0s;          h_k0s          = 0;
+  delete h_k_DCC;        h_k_DCC        = 0;
+  delete h_kc_DCC;       h_kc_DCC       = 0;
+  delete h_k0_DCC;       h_k0_DCC       = 0;
+  delete h_k0s_DCC;      h_k0s_DCC      = 0;
+  delete h_k_Binomial;   h_k_Binomial   = 0;
+  delete h_kc_Binomial;  h_kc_Binomial  = 0;
+  delete h_k0_Binomial;  h_k0_Binomial  = 0;
+  delete h_k0s_Binomial; h_k0s_Binomial = 0;
+  delete h_kck0;         h_kck0         = 0;
+  delete h_kck0s;        h_kck0s        = 0;
+  }
+  
+  void setHisto(TH1 * h, int markerStyle, int markerColor, float markerSize, int lineStyle, int lineColor, const TString & xTitle, const TString & yTitle)
+  {
+  h->SetStats(0);
+  
+  h->GetXaxis()->SetTitle(xTitle);
+  h->GetXaxis()->SetTitleSize(0.05);
+  h->GetXaxis()->SetTitleOffset(0.8);
+  
+  h->GetYaxis()->SetTitle(yTitle);
+  h->GetYaxis()->SetTitleSize(0.05);
+  h->GetYaxis()->SetTitleOffset(0.95);
+  
+  h->SetMarkerStyle(markerStyle);
+  h->SetMarkerColor(markerColor);
+  h->SetMarkerSize(markerSize);
+  h->SetLineStyle(lineStyle);
+  h->SetLineColor(lineColor);
+  }
+  
+
+  
+  ////////////////////////////////////////////
+  // Print the moments
+  ////////////////////////////////////////////
+  void print(ostream & os)
+  {
+  os << "----------------------------------------------------" << endl;
+  os << "                 k: " << k_avg << endl;
+  os << "                k0: " << k0_avg << endl;
+  os << "               k0s: " << k0s_avg << endl;
+  os << "                kc: " << kc_avg << endl;
+  os << "        k_Binomial: " << k_Binomial_avg << endl;
+  os << "       k0_Binomial: " << k0_Binomial_avg  << endl;
+  os << "      k0s_Binomial: " << k0s_Binomial_avg  << endl;
+  os << "       kc_Binomial: " << kc_Binomial_avg  << endl;
+  os << "             k_DCC: " << k_DCC_avg << endl;
+  os << "            k0_DCC: " << k0_DCC_avg  << endl;
+  os << "           k0s_DCC: " << k0s_DCC_avg  << endl;
+  os << "            kc_DCC: " << kc_DCC_avg  << endl;
+  os << "           nEvents: " << nEvents << endl;
+  os << "         nuDyn_ch0: " << nuDyn_ch0  << " +- " << nuDyn_ch0_err  << endl;
+  os << "        nuDyn_ch0s: " << nuDyn_ch0s << " +- " << nuDyn_ch0s_err << endl;
+  os << "         nuDyn_00s: " << nuDyn_00s << endl;
+  os << "     nuDyn_ch0_DCC: " << nuDyn_ch0_DCC << endl;
+  os << "    nuDyn_ch0s_DCC: " << nuDyn_ch0s_DCC << endl;
+  }
+  
+  ////////////////////////////////////////////
+  // Calculate moments and scale
+  // histograms to per event values. The
+  // histograms are rebuilt from the counts
+  // every time, since fill() and add() may
+  // have changed them since the last plot.
+  ////////////////////////////////////////////
+  void plotHistograms()
+  {
+  makeHistograms();
+  if (!h_k) return;
+  
+  TString plotOption2D = "colz";
+  
+  setHisto(h_k,  20,1,0.5,1,1, "k", "counts");
+  setHisto(h_kc, 21,2,0.5,2,1, "kc", "counts");
+  setHisto(h_k0, 22,4,0.5,3,1, "k0", "counts");
+  setHisto(h_k0s,23,6,0.5,4,1, "k0s", "counts");
+  
+  setHisto(h_k_DCC,  20,2,0.5,1,2, "k (DCC)", "counts");
+  setHisto(h_kc_DCC, 21,2,0.5,2,2, "kc (DCC)", "counts");
+  setHisto(h_k0_DCC, 22,2,0.5,3,2, "k0 (DCC)", "counts");
+  setHisto(h_k0s_DCC,23,2,0.5,4,2, "ks (DCC)", "counts");
+  
+  setHisto(h_k_Binomial,  21,4,0.5,1,4, "k (Binomial)", "counts");
+  setHisto(h_kc_Binomial, 22,4,0.5,2,4, "kc (Binomial)", "counts");
+  setHisto(h_k0_Binomial, 23,4,0.5,3,4, "k0 (Binomial)", "counts");
+  setHisto(h_k0s_Binomial,24,4,0.5,4,4, "k0s (Binomial)", "counts");
+  
+  TString canvasName;
+  TString pdfName;
+
+  canvasName = baseName;
+  canvasName += "KaonMultDist";
+  TCanvas * c1 = new TCanvas(canvasName,canvasName,5,5,1000,800);
+  c1->Divide(1,3);
+  c1->cd(1);
+  gPad-> SetLogy();
+  
+  h_k->SetMinimum(1e-7);
+  h_k->SetMaximum(5e-1);
+  h_k->Draw();
+  h_kc->Draw("SAME");
+  h_k0->Draw("SAME");
+  h_k0s->Draw("SAME");
+  
+  TLegend * l1 = createLegend(0.5, 0.9, 0.78, 0.85, 0.1, 4);
+  l1->AddEntry(h_k,   "K",        "p");
+  l1->AddEntry(h_kc,  "K^{c}",    "p");
+  l1->AddEntry(h_k0,  "K^{0}",    "p");
+  l1->AddEntry(h_k0s, "K_{s}^{0}","p");
+  l1->Draw();
+  
+  c1->cd(2);
+  gPad-> SetLogy();
+  
+  h_k_DCC->SetMinimum(1e-7);
+  h_k_DCC->SetMaximum(5e-1);
+  h_k_DCC->Draw();
+  h_kc_DCC->Draw("SAME");
+  h_k0_DCC->Draw("SAME");
+  h_k0s_DCC->Draw("SAME");
+  TLegend * l2 = createLegend(0.5, 0.9, 0.78, 0.85, 0.1, 4);
+  l2->AddEntry(h_k_DCC,   "K_{DCC}",        "p");
+  l2->AddEntry(h_kc_DCC,  "K_{DCC}^{c}",    "p");
+  l2->AddEntry(h_k0_DCC,  "K_{DCC}^{0} ",   "p");
+  l2->AddEntry(h_k0s_DCC, "K_{s,DCC}^{0}",  "p");
+  l2->Draw();
+  
+  c1->cd(3);
+  gPad-> SetLogy();
+  
+  h_k_Binomial->SetMinimum(1e-7);
+  h_k_Binomial->SetMaximum(5e-1);
+  h_k_Binomial->Draw();
+  h_kc_Binomial->Draw("SAME");
+  h_k0_Binomial->Draw("SAME");
+  h_k0s_Binomial->Draw("SAME");
+  TLegend * l3 = createLegend(0.5, 0.9, 0.78, 0.85, 0.1, 4);
+  l3->AddEntry(h_k_Binomial,   "K_{b}",        "p");
+  l3->AddEntry(h_kc_Binomial,  "K_{b}^{c}",    "p");
+  l3->AddEntry(h_k0_Binomial,  "K_{b}^{0} ",   "p");
+  l3->AddEntry(h_k0s_Binomial, "K_{s,b}^{0}",  "p");
+  l3->Draw();
+ 
+  pdfName = canvasName;
+  pdfName += ".pdf";
+  c1->Print(pdfName);
+  
+  canvasName = baseName;
+  canvasName += "k0Vskc";
+  TCanvas * c2 = new TCanvas(canvasName,canvasName,50,5,800,800);
+  gPad-> SetLogz(true);
+  h_kck0->Draw(plotOption2D);
+  pdfName = canvasName;
+  pdfName += ".pdf";
+  c2->Print(pdfName);
+
+  canvasName = baseName;
+  canvasName += "k0sVskc";
+  TCanvas * c3 = new TCanvas(canvasName,canvasName,150,5,800,800);
+  gPad-> SetLogz(true);
+  h_kck0s->Draw(plotOption2D);
+  pdfName = canvasName;
+  pdfName += ".pdf";
+  c3->Print(pdfName);
+
+  }
+  
+  
+};
+
+class KaonGenerator
+{
+public:
+  
+  ////////////////////////////////////////////
+  // Data members
+  ////////////////////////////////////////////
+  int    minMult;
+  int    maxMult;
+  double kaonFraction;
+  double dccFraction;
+  unsigned int seed;
+  // TRandom3 specifically: binomialHalfKernel()
+  // recovers its raw 32 bit words
+  TRandom3 * random;
+  
+  // scratch space of the batched generator
+  double       * rndm;
+  int            rndmCapacity;
+  unsigned int * bits;
+  int            bitsCapacity;
+  
+  ////////////////////////////////////////////
+  // CTOR
+  ////////////////////////////////////////////
+  KaonGenerator(int min_Mult,
+                int max_Mult,
+                double frac_kaon,
+                double frac_dcc,
+                unsigned int aSeed=4357)
+  {
+  minMult      = min_Mult;
+  maxMult      = max_Mult;
+  kaonFraction = frac_kaon;
+  dccFraction  = frac_dcc;
+  seed         = aSeed;
+  random       = new TRandom3(seed);
+  rndm         = 0;
+  rndmCapacity = 0;
+  bits         = 0;
+  bitsCapacity = 0;
+  }
+  
+  ////////////////////////////////////////////
+  // DTOR
+  ////////////////////////////////////////////
+  ~KaonGenerator()
+  {
+  delete random;
+  delete [] rndm;
+  delete [] bits;
+  }
+  
+  void generate(KaonEvent & event)
+  {
+  event.centrality = random->Uniform(minMult,maxMult);
+  
+  // Total kaons in event
+  event.k  = random->Binomial(event.centrality,kaonFraction);
+  
+  if (dccFraction==0.0) // pure binomial case
+    {
+    // no dcc kaons
+    event.k_DCC   = 0.0;
+    event.k0_DCC  = 0.0;
+    event.k0s_DCC = 0.0;
+    event.kc_DCC  = 0.0;
+    // binomial generation
+    event.k_Binomial   = event.k;
+    event.k0_Binomial  = random->Binomial(event.k_Binomial,  0.5); // half the kaons are neutral on average
+    event.k0s_Binomial = random->Binomial(event.k0_Binomial, 0.5); // half the neutral kaons are k-short on average
+    event.kc_Binomial  = event.k_Binomial - event.k0_Binomial;
+    }
+  else if (dccFraction==1.0)  // pure DCC case
+    {
+    // dcc generation
+    event.k_DCC   = event.k;
+    event.k0Fraction_DCC = random->Uniform(0.0, 1.0); // uniform fraction of neutral kaons
+    event.k0_DCC  =  event.k_DCC * event.k0Fraction_DCC;
+    event.k0s_DCC =  random->Binomial(event.k0_DCC, 0.5);; // half the neutral kaons are k-short on average
+    event.kc_DCC  =  event.k_DCC - event.k0_DCC;
+    // no binomial kaons
+    event.k_Binomial   = 0.0;
+    event.k0_Binomial  = 0.0;
+    event.k0s_Binomial = 0.0;
+    event.kc_Binomial  = 0.0;
+    
+    }
+  else // dccFraction is between 0 and 1
+    {
+    // dcc generation
+    event.k_DCC    = dccFraction * event.k;
+    event.k0Fraction_DCC = random->Uniform(0.0, 1.0); // uniform fraction of neutral kaons
+    event.k0_DCC   =  event.k_DCC * event.k0Fraction_DCC;
+    event.k0s_DCC  =  random->Binomial(event.k0_DCC, 0.5);; // half the neutral kaons are k-short on average
+    event.kc_DCC   =  event.k_DCC - event.k0_DCC;
+    // binomial generation
+    event.k_Binomial   = event.k - event.k_DCC;
+    event.k0_Binomial  = random->Binomial(event.k_Binomial,  0.5); // half the kaons are neutral on average
+    event.k0s_Binomial = random->Binomial(event.k0_Binomial, 0.5); // half the neutral kaons are k-short on average
+    event.kc_Binomial  = event.k_Binomial - event.k0_Binomial;
+    }
+  
+
+    event.k0  = event.k0_Binomial  + event.k0_DCC;
+    event.k0s = event.k0s_Binomial + event.k0s_DCC;
+    event.kc  = event.kc_Binomial  + event.kc_DCC;
+
+  
+  event.k0Fraction  = double(event.k0)/double(event.k);
+  event.k0sFraction = double(event.k0s)/double(event.k);
+  event.k0Fraction_DCC  = double(event.k0_DCC)/double(event.k_DCC);
+  event.k0sFraction_DCC = double(event.k0s_DCC)/double(event.k_DCC);
+  event.k0Fraction_Binomial  = double(event.k0_Binomial)/double(event.k_Binomial);
+  event.k0sFraction_Binomial = double(event.k0s_Binomial)/double(event.k_Binomial);
+  
+  }
+  
+  ////////////////////////////////////////////
+  // Scratch buffer of at least n doubles
+  ////////////////////////////////////////////
+  double * rndmBuffer(int n)
+  {
+  if (n>rndmCapacity)
+    {
+    delete [] rndm;
+    rndmCapacity = (n>2*rndmCapacity) ? n : 2*rndmCapacity;
+    rndm = new double[rndmCapacity];
+    }
+  return rndm;
+  }
+  
+  ////////////////////////////////////////////
+  // Scratch buffer of at least n words
+  ////////////////////////////////////////////
+  unsigned int * bitsBuffer(int n)
+  {
+  if (n>bitsCapacity)
+    {
+    delete [] bits;
+    bitsCapacity = (n>2*bitsCapacity) ? n : 2*bitsCapacity;
+    bits = new unsigned int[bitsCapacity];
+    }
+  return bits;
+  }
+  
+  static int popCount(unsigned int x)
+  {
+  x = x - ((x >> 1) & 0x55555555u);
+  x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+  x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+  return (x * 0x01010101u) >> 24;
+  }
+  
+  ////////////////////////////////////////////
+  // out[i] = Uniform(low,high) for n values
+  ////////////////////////////////////////////
+  void uniformKernel(double * out, int n, double low, double high)
+  {
+  random->RndmArray(n, out);
+  double width = high - low;
+  for (int i=0; i<n; i++) out[i] = low + width*out[i];
+  }
+  
+  ////////////////////////////////////////////
+  // out[i] = Binomial(n[i], p) for nEvents
+  // values (out may be n). TRandom::Binomial()
+  // counts the Rndm() <= p among n draws; the
+  // same count over RndmArray() blocks takes
+  // the same uniforms, so the same k for a
+  // given seed, without a virtual call per
+  // draw and with a branch free inner loop.
+  ////////////////////////////////////////////
+  void binomialKernel(const int * n, double p, int * out, int nEvents)
+  {
+  if (p<0.0 || p>1.0)
+    {
+    for (int i=0; i<nEvents; i++) out[i] = 0;
+    return;
+    }
+  const int blockSize = 16384;
+  long long nLeft = 0;
+  for (int i=0; i<nEvents; i++) if (n[i]>0) nLeft += n[i];
+  double * u = rndmBuffer(blockSize);
+  int nBlock = 0;
+  int next   = 0;
+  for (int i=0; i<nEvents; i++)
+    {
+    int m = n[i];
+    int count = 0;
+    while (m>0)
+      {
+      if (next==nBlock)
+        {
+        // draw exactly the uniforms used
+        nBlock = (nLeft<blockSize) ? int(nLeft) : blockSize;
+        random->RndmArray(nBlock, u);
+        nLeft -= nBlock;
+        next   = 0;
+        }
+      int l = nBlock - next;
+      if (l>m) l = m;
+      for (int j=next; j<next+l; j++) count += (u[j]<=p);
+      next += l;
+      m    -= l;
+      }
+    out[i] = count;
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // out[i] = Binomial(n[i], 0.5) for nEvents
+  // values. A Binomial(n,1/2) is the number of
+  // set bits among n random bits, so the draw
+  // is a popcount over 32-bit words. TRandom3
+  // returns Rndm() = y/2^32 with y the raw
+  // Mersenne Twister word (y=0 is skipped), so
+  // y*2^32 recovers the word exactly.
+  ////////////////////////////////////////////
+  void binomialHalfKernel(const int * n, int * out, int nEvents)
+  {
+  int nWords = 0;
+  for (int i=0; i<nEvents; i++) nWords += (n[i]+31) >> 5;
+  double       * u = rndmBuffer(nWords);
+  unsigned int * w = bitsBuffer(nWords);
+  random->RndmArray(nWords, u);
+  for (int j=0; j<nWords; j++) w[j] = (unsigned int) (u[j] * 4294967296.0);
+  
+  int iWord = 0;
+  for (int i=0; i<nEvents; i++)
+    {
+    int nFull = n[i] >> 5;
+    int nLast = n[i] & 31;
+    int count = 0;
+    for (int j=0; j<nFull; j++) count += popCount(w[iWord+j]);
+    iWord += nFull;
+    if (nLast>0)
+      {
+      count += popCount(w[iWord] & ((1u << nLast) - 1u));
+      iWord++;
+      }
+    out[i] = count;
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // Generate nEvents events into the columns
+  // of batch, one pass per field. The draws
+  // are statistically equivalent to
+  // generate(KaonEvent&) but the random
+  // sequence differs.
+  ////////////////////////////////////////////
+  void generate(KaonEventBatch & batch, int nEvents)
+  {
+  generateBase(batch, nEvents);
+  generateSplit(batch);
+  }
+  
+  ////////////////////////////////////////////
+  // First part of generate(): centrality and
+  // total kaons, the only draws that do not
+  // depend on dccFraction
+  ////////////////////////////////////////////
+  void generateBase(KaonEventBatch & batch, int nEvents)
+  {
+  if (nEvents>batch.capacity) nEvents = batch.capacity;
+  batch.nEvents = nEvents;
+  
+  uniformKernel(batch.centrality, nEvents, minMult, maxMult);
+  
+  // Total kaons in event
+  for (int i=0; i<nEvents; i++) batch.k[i] = int(batch.centrality[i]);
+  binomialKernel(batch.k, kaonFraction, batch.k, nEvents);
+  }
+  
+  ////////////////////////////////////////////
+  // Second part of generate(): DCC and
+  // binomial split of the batch.k kaons. With
+  // sharedK0Fraction the DCC neutral fractions
+  // already in batch.k0Fraction_DCC are used
+  // instead of drawing them.
+  ////////////////////////////////////////////
+  void generateSplit(KaonEventBatch & batch, bool sharedK0Fraction=false)
+  {
+  int nEvents = batch.nEvents;
+  
+  if (dccFraction==0.0) // pure binomial case
+    {
+    for (int i=0; i<nEvents; i++)
+      {
+      batch.k_DCC[i]   = 0;
+      batch.k0_DCC[i]  = 0;
+      batch.k0s_DCC[i] = 0;
+      batch.kc_DCC[i]  = 0;
+      batch.k0Fraction_DCC[i] = 0.0;
+      }
+    }
+  else
+    {
+    // dcc generation: uniform fraction of neutral kaons,
+    // half the neutral kaons are k-short on average
+    if (!sharedK0Fraction) uniformKernel(batch.k0Fraction_DCC, nEvents, 0.0, 1.0);
+    for (int i=0; i<nEvents; i++)
+      {
+      batch.k_DCC[i]  = dccFraction * batch.k[i];
+      batch.k0_DCC[i] = batch.k_DCC[i] * batch.k0Fraction_DCC[i];
+      batch.kc_DCC[i] = batch.k_DCC[i] - batch.k0_DCC[i];
+      }
+    binomialHalfKernel(batch.k0_DCC, batch.k0s_DCC, nEvents);
+    }
+  
+  // binomial generation: half the kaons are neutral on average,
+  // half the neutral kaons are k-short on average
+  for (int i=0; i<nEvents; i++) batch.k_Binomial[i] = batch.k[i] - batch.k_DCC[i];
+  binomialHalfKernel(batch.k_Binomial,  batch.k0_Binomial,  nEvents);
+  binomialHalfKernel(batch.k0_Binomial, batch.k0s_Binomial, nEvents);
+  for (int i=0; i<nEvents; i++) batch.kc_Binomial[i] = batch.k_Binomial[i] - batch.k0_Binomial[i];
+  
+  for (int i=0; i<nEvents; i++)
+    {
+    batch.k0[i]  = batch.k0_Binomial[i]  + batch.k0_DCC[i];
+    batch.k0s[i] = batch.k0s_Binomial[i] + batch.k0s_DCC[i];
+    batch.kc[i]  = batch.kc_Binomial[i]  + batch.kc_DCC[i];
+    }
+  }
+};
+
+////////////////////////////////////////////
+// Exact expectation values of the factorial
+// moments of KaonGenerator, without events.
+// The generator draws
+//   N    = int(Uniform(minMult,maxMult)), uniform on minMult..maxMult-1
+//   k    ~ Binomial(N, kaonFraction)
+//   kD   = int(dccFraction*k),  kb = k - kD
+//   k0D  = int(kD*Uniform(0,1)), uniform on 0..kD-1
+//   k0b  ~ Binomial(kb, 0.5)
+//   k0   = k0b + k0D,  kc = k - k0
+//   k0s  ~ Binomial(k0, 0.5)
+// so the moments given k follow from <k0|k>
+// and <k0^2|k>, and the unconditional ones
+// from one sum over P(k), itself obtained
+// from two binomial rows: the whole
+// calculation is O(maxMult). The factorial
+// sums are filled with probabilities as
+// weights (sums[0] = 1), so that R and nuDyn
+// are obtained exactly as for KaonMoments.
+////////////////////////////////////////////
+class KaonExactMoments
+{
+public:
+  
+  int    minMult;
+  int    maxMult;
+  double kaonFraction;
+  double dccFraction;
+  
+  KaonMoments::TotalFactorials    factorials;
+  KaonMoments::BinomialFactorials factorials_Binomial;
+  KaonMoments::DccFactorials      factorials_DCC;
+  
+  double r00;
+  double r0s0s;
+  double rchch;
+  double rch0;
+  double rch0s;
+  double nuDyn_ch0;
+  double nuDyn_ch0s;
+  
+  double r00s;
+  double nuDyn_00s;
+  double nuDyn_ch0_DCC;
+  double nuDyn_ch0s_DCC;
+  
+  KaonExactMoments(double kaonF,
+                   double dccF,
+                   int    min_Mult,
+                   int    max_Mult)
+  :
+  minMult(min_Mult),
+  maxMult(max_Mult),
+  kaonFraction(kaonF),
+  dccFraction(dccF)
+  {
+  calculateMoments();
+  }
+  
+  KaonExactMoments(const KaonGenerator & generator)
+  :
+  minMult(generator.minMult),
+  maxMult(generator.maxMult),
+  kaonFraction(generator.kaonFraction),
+  dccFraction(generator.dccFraction)
+  {
+  calculateMoments();
+  }
+  
+  ////////////////////////////////////////////
+  // Binomial probabilities P[j], j=0..n,
+  // by recursion away from the mode (no
+  // underflow of p^n for large n)
+  ////////////////////////////////////////////
+  static void binomialProbabilities(int n, double p, double * P)
+  {
+  for (int j=0; j<=n; j++) P[j] = 0.0;
+  if (p<=0.0) { P[0] = 1.0; return; }
+  if (p>=1.0) { P[n] = 1.0; return; }
+  int mode = int((n+1)*p);
+  if (mode>n) mode = n;
+  P[mode] = TMath::Exp(TMath::LnGamma(n+1.0) - TMath::LnGamma(mode+1.0) - TMath::LnGamma(n-mode+1.0)
+                       + mode*TMath::Log(p) + (n-mode)*TMath::Log(1.0-p));
+  double odds = p/(1.0-p);
+  for (int j=mode; j<n; j++)  P[j+1] = P[j] * odds * (n-j)/(j+1.0);
+  for (int j=mode; j>0; j--)  P[j-1] = P[j] / odds * j/(n-j+1.0);
+  }
+  
+  ////////////////////////////////////////////
+  // Add weight times the factorial moments of
+  // (k, kc, k0, k0s) given k=m, <k0>=m1 and
+  // <k0^2>=m2, with k0s ~ Binomial(k0, 0.5)
+  ////////////////////////////////////////////
+  template <class Factorials>
+  static void addConditional(Factorials & f, double weight, double m, double m1, double m2)
+  {
+  double s[Factorials::nSums];
+  double c1 = m - m1;
+  double c2 = m*m - 2.0*m*m1 + m2;
+  s[0] = 1.0;
+  s[Factorials::singleIndex(KaonSpecies::k,   1)] = m;
+  s[Factorials::singleIndex(KaonSpecies::k,   2)] = m*(m-1.0);
+  s[Factorials::singleIndex(KaonSpecies::kc,  1)] = c1;
+  s[Factorials::singleIndex(KaonSpecies::kc,  2)] = c2 - c1;
+  s[Factorials::singleIndex(KaonSpecies::k0,  1)] = m1;
+  s[Factorials::singleIndex(KaonSpecies::k0,  2)] = m2 - m1;
+  s[Factorials::singleIndex(KaonSpecies::k0s, 1)] = 0.5*m1;
+  s[Factorials::singleIndex(KaonSpecies::k0s, 2)] = 0.25*(m2 - m1);
+  s[Factorials::pairIndex(KaonSpecies::k,  KaonSpecies::kc,  1,1)] = m*c1;
+  s[Factorials::pairIndex(KaonSpecies::k,  KaonSpecies::k0,  1,1)] = m*m1;
+  s[Factorials::pairIndex(KaonSpecies::k,  KaonSpecies::k0s, 1,1)] = 0.5*m*m1;
+  s[Factorials::pairIndex(KaonSpecies::kc, KaonSpecies::k0,  1,1)] = m*m1 - m2;
+  s[Factorials::pairIndex(KaonSpecies::kc, KaonSpecies::k0s, 1,1)] = 0.5*(m*m1 - m2);
+  s[Factorials::pairIndex(KaonSpecies::k0, KaonSpecies::k0s, 1,1)] = 0.5*m2;
+  for (int i=0; i<Factorials::nSums; i++) f.sums[i] += weight*s[i];
+  }
+  
+  void calculateMoments()
+  {
+  factorials.reset();
+  factorials_Binomial.reset();
+  factorials_DCC.reset();
+  if (maxMult<=minMult || minMult<0)
+    {
+    cout << "-E- calculateMoments() Invalid multiplicity range " << minMult << " - " << maxMult << endl;
+    return;
+    }
+  
+  // P(k), averaged over the centrality. With
+  //   sum_{n<N} Binomial(k; n,p) = P(Binomial(N,p) > k)/p
+  // the sum over minMult <= n < maxMult takes
+  // the two binomial rows of N = minMult and
+  // N = maxMult instead of one row per n.
+  // Whichever of the lower or upper tails are
+  // small is subtracted, to keep the precision.
+  int nMax = maxMult - 1;
+  double * pK = new double[nMax+1];
+  if (kaonFraction<=0.0)
+    {
+    for (int k=0; k<=nMax; k++) pK[k] = 0.0;
+    pK[0] = 1.0;
+    }
+  else
+    {
+    double * pMin     = new double[maxMult+1];
+    double * pMax     = new double[maxMult+1];
+    double * upperMin = new double[maxMult+1];
+    double * upperMax = new double[maxMult+1];
+    binomialProbabilities(minMult, kaonFraction, pMin);
+    binomialProbabilities(maxMult, kaonFraction, pMax);
+    for (int j=minMult+1; j<=maxMult; j++) pMin[j] = 0.0;
+    // upper tails P(Binomial(N,p) > k)
+    upperMin[maxMult] = 0.0;
+    upperMax[maxMult] = 0.0;
+    for (int k=maxMult-1; k>=0; k--)
+      {
+      upperMin[k] = upperMin[k+1] + pMin[k+1];
+      upperMax[k] = upperMax[k+1] + pMax[k+1];
+      }
+    // lower tails P(Binomial(N,p) <= k)
+    double lowerMin = 0.0;
+    double lowerMax = 0.0;
+    double norm = 1.0/(kaonFraction*(maxMult - minMult));
+    for (int k=0; k<=nMax; k++)
+      {
+      lowerMin += pMin[k];
+      lowerMax += pMax[k];
+      if (lowerMin<=0.5)
+        pK[k] = norm*(lowerMin - lowerMax);
+      else
+        pK[k] = norm*(upperMax[k] - upperMin[k]);
+      if (pK[k]<0.0) pK[k] = 0.0;
+      }
+    delete [] pMin;
+    delete [] pMax;
+    delete [] upperMin;
+    delete [] upperMax;
+    }
+  
+  for (int k=0; k<=nMax; k++)
+    {
+    if (pK[k]==0.0) continue;
+    // same truncation as the generator
+    int kD = dccFraction * k;
+    int kb = k - kD;
+    // k0b ~ Binomial(kb, 0.5)
+    double mean_b = 0.5*kb;
+    double var_b  = 0.25*kb;
+    // k0D uniform on 0..kD-1
+    double mean_D = kD>0 ? 0.5*(kD-1.0)         : 0.0;
+    double var_D  = kD>0 ? (kD*double(kD)-1.0)/12.0 : 0.0;
+    double mean   = mean_b + mean_D;
+    addConditional(factorials,          pK[k], k,  mean,   var_b + var_D + mean*mean);
+    addConditional(factorials_Binomial, pK[k], kb, mean_b, var_b + mean_b*mean_b);
+    addConditional(factorials_DCC,      pK[k], kD, mean_D, var_D + mean_D*mean_D);
+    }
+  delete [] pK;
+  
+  r00   = factorials.R(KaonSpecies::k0,  KaonSpecies::k0);
+  r0s0s = factorials.R(KaonSpecies::k0s, KaonSpecies::k0s);
+  rchch = factorials.R(KaonSpecies::kc,  KaonSpecies::kc);
+  rch0  = factorials.R(KaonSpecies::kc,  KaonSpecies::k0);
+  rch0s = factorials.R(KaonSpecies::kc,  KaonSpecies::k0s);
+  nuDyn_ch0  = rchch + r00 - 2.0*rch0;
+  nuDyn_ch0s = rchch + r0s0s - 2.0*rch0s;
+  
+  r00s      = factorials.R(KaonSpecies::k0, KaonSpecies::k0s);
+  nuDyn_00s = factorials.nuDyn(KaonSpecies::k0, KaonSpecies::k0s);
+  nuDyn_ch0_DCC  = factorials_DCC.nuDyn(KaonSpecies::kc, KaonSpecies::k0);
+  nuDyn_ch0s_DCC = factorials_DCC.nuDyn(KaonSpecies::kc, KaonSpecies::k0s);
+  }
+  
+  void print(ostream & os)
+  {
+  os << "----------------------------------------------------" << endl;
+  os << "                 k: " << factorials.mean(KaonSpecies::k)   << endl;
+  os << "                k0: " << factorials.mean(KaonSpecies::k0)  << endl;
+  os << "               k0s: " << factorials.mean(KaonSpecies::k0s) << endl;
+  os << "                kc: " << factorials.mean(KaonSpecies::kc)  << endl;
+  os << "               r00: " << r00   << endl;
+  os << "             r0s0s: " << r0s0s << endl;
+  os << "             rchch: " << rchch << endl;
+  os << "              rch0: " << rch0  << endl;
+  os << "             rch0s: " << rch0s << endl;
+  os << "         nuDyn_ch0: " << nuDyn_ch0  << endl;
+  os << "        nuDyn_ch0s: " << nuDyn_ch0s << endl;
+  os << "         nuDyn_00s: " << nuDyn_00s << endl;
+  os << "     nuDyn_ch0_DCC: " << nuDyn_ch0_DCC << endl;
+  os << "    nuDyn_ch0s_DCC: " << nuDyn_ch0s_DCC << endl;
+  }
+  
+  ////////////////////////////////////////////
+  // Cross check against Monte Carlo moments:
+  // prints exact value, MC value +- error and
+  // the pull for the observables with errors.
+  // Returns false if a pull exceeds maxPull.
+  ////////////////////////////////////////////
+  bool compare(const KaonMoments & moments, ostream & os, double maxPull=5.0)
+  {
+  const char * names[7]  = { "r00", "r0s0s", "rchch", "rch0", "rch0s", "nuDyn_ch0", "nuDyn_ch0s" };
+  double exact[7]  = { r00, r0s0s, rchch, rch0, rch0s, nuDyn_ch0, nuDyn_ch0s };
+  double mc[7]     = { moments.r00, moments.r0s0s, moments.rchch, moments.rch0, moments.rch0s,
+                       moments.nuDyn_ch0, moments.nuDyn_ch0s };
+  double errors[7] = { moments.r00_err, moments.r0s0s_err, moments.rchch_err, moments.rch0_err, moments.rch0s_err,
+                       moments.nuDyn_ch0_err, moments.nuDyn_ch0s_err };
+  bool agree = true;
+  os << "----------------------------------------------------" << endl;
+  os << "  exact vs MC, nEvents: " << moments.nEvents << endl;
+  for (int i=0; i<7; i++)
+    {
+    double pull = errors[i]>0.0 ? (mc[i] - exact[i])/errors[i] : 0.0;
+    if (TMath::Abs(pull)>maxPull) agree = false;
+    os << setw(18) << names[i] << ": " << exact[i] << "   " << mc[i] << " +- " << errors[i]
+       << "   pull: " << pull << endl;
+    }
+  if (!agree) cout << "-W- compare() Exact and MC moments differ by more than " << maxPull << " sigma" << endl;
+  return agree;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Columnar event output: one TTree entry per
+// block of up to entrySize events, with the
+// independent fields only as counted arrays
+// of 16 bit integers (plus the centrality,
+// kept exact for h_centrality). The other
+// fields follow from
+//   kc = k - k0,  kc_DCC = k_DCC - k0_DCC
+//   x_Binomial = x - x_DCC
+////////////////////////////////////////////
+class KaonEventWriter
+{
+public:
+  
+  TFile * file;
+  TTree * tree;
+  int     entrySize;
+  
+  // events of the current entry
+  int        n;
+  double   * centrality;
+  UShort_t * k;
+  UShort_t * k0;
+  UShort_t * k0s;
+  UShort_t * k_DCC;
+  UShort_t * k0_DCC;
+  UShort_t * k0s_DCC;
+  
+  ////////////////////////////////////////////
+  // CTOR
+  // compression: ROOT compression setting,
+  // e.g. 101 (zlib 1) or 404 (lz4 4)
+  // entrySize: events per TTree entry
+  ////////////////////////////////////////////
+  KaonEventWriter(const TString & fileName,
+                  const KaonGenerator & generator,
+                  int compression=404,
+                  int entrySizeOption=8192)
+  {
+  tree       = 0;
+  entrySize  = entrySizeOption;
+  n          = 0;
+  centrality = 0;
+  k          = 0;
+  k0         = 0;
+  k0s        = 0;
+  k_DCC      = 0;
+  k0_DCC     = 0;
+  k0s_DCC    = 0;
+  if (generator.maxMult>65535)
+    {
+    cout << "-E- KaonEventWriter(...) maxMult>65535 does not fit the 16 bit branches -- No event output" << endl;
+    file = 0;
+    return;
+    }
+  file = TFile::Open(fileName, "RECREATE", "", compression);
+  if (!file || file->IsZombie())
+    {
+    cout << "-E- KaonEventWriter(...) Cannot open file:" << fileName << endl;
+    delete file;
+    file = 0;
+    return;
+    }
+  TVectorD parameters(6);
+  parameters[0] = generator.minMult;
+  parameters[1] = generator.maxMult;
+  parameters[2] = generator.kaonFraction;
+  parameters[3] = generator.dccFraction;
+  parameters[4] = generator.seed;
+  parameters[5] = entrySize;
+  file->WriteTObject(&parameters, "generator");
+  
+  centrality = new double[entrySize];
+  k          = new UShort_t[entrySize];
+  k0         = new UShort_t[entrySize];
+  k0s        = new UShort_t[entrySize];
+  k_DCC      = new UShort_t[entrySize];
+  k0_DCC     = new UShort_t[entrySize];
+  k0s_DCC    = new UShort_t[entrySize];
+  
+  int bufferSize = 256000;
+  tree = new TTree("events", "Kaon DCC toy model events");
+  tree->SetDirectory(file);
+  tree->Branch("n",          &n,         "n/I",             bufferSize);
+  tree->Branch("centrality", centrality, "centrality[n]/D", bufferSize);
+  tree->Branch("k",          k,          "k[n]/s",          bufferSize);
+  tree->Branch("k0",         k0,         "k0[n]/s",         bufferSize);
+  tree->Branch("k0s",        k0s,        "k0s[n]/s",        bufferSize);
+  tree->Branch("k_DCC",      k_DCC,      "k_DCC[n]/s",      bufferSize);
+  tree->Branch("k0_DCC",     k0_DCC,     "k0_DCC[n]/s",     bufferSize);
+  tree->Branch("k0s_DCC",    k0s_DCC,    "k0s_DCC[n]/s",    bufferSize);
+  }
+  
+  ~KaonEventWriter()
+  {
+  close();
+  delete [] centrality;
+  delete [] k;
+  delete [] k0;
+  delete [] k0s;
+  delete [] k_DCC;
+  delete [] k0_DCC;
+  delete [] k0s_DCC;
+  }
+  
+  void write(const KaonEventBatch & batch)
+  {
+  write(batch, 0, batch.nEvents);
+  }
+  
+  // events first to first+nWrite-1 of batch
+  void write(const KaonEventBatch & batch, int first, int nWrite)
+  {
+  if (!tree) return;
+  int last = first + nWrite;
+  while (first<last)
+    {
+    int m = last - first;
+    if (m>entrySize-n) m = entrySize - n;
+    std::copy(batch.centrality+first, batch.centrality+first+m, centrality+n);
+    std::copy(batch.k+first,          batch.k+first+m,          k+n);
+    std::copy(batch.k0+first,         batch.k0+first+m,         k0+n);
+    std::copy(batch.k0s+first,        batch.k0s+first+m,        k0s+n);
+    std::copy(batch.k_DCC+first,      batch.k_DCC+first+m,      k_DCC+n);
+    std::copy(batch.k0_DCC+first,     batch.k0_DCC+first+m,     k0_DCC+n);
+    std::copy(batch.k0s_DCC+first,    batch.k0s_DCC+first+m,    k0s_DCC+n);
+    n     += m;
+    first += m;
+    if (n==entrySize) flush();
+    }
+  }
+  
+  void write(const KaonEvent & event)
+  {
+  if (!tree) return;
+  centrality[n] = event.centrality;
+  k[n]          = event.k;
+  k0[n]         = event.k0;
+  k0s[n]        = event.k0s;
+  k_DCC[n]      = event.k_DCC;
+  k0_DCC[n]     = event.k0_DCC;
+  k0s_DCC[n]    = event.k0s_DCC;
+  n++;
+  if (n==entrySize) flush();
+  }
+  
+  // write the pending events as one entry
+  void flush()
+  {
+  if (!tree || n==0) return;
+  tree->Fill();
+  n = 0;
+  }
+  
+  void close()
+  {
+  if (!file) return;
+  flush();
+  // TTree::Write() also flushes the baskets
+  tree->Write();
+  file->Close();
+  delete file;
+  file = 0;
+  tree = 0;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Streams the events written by
+// KaonEventWriter back into event batches,
+// one GetEntry per block of events. Entries
+// are read sequentially through a large
+// TTreeCache.
+////////////////////////////////////////////
+class KaonEventReader
+{
+public:
+  
+  TFile *  file;
+  TTree *  tree;
+  Long64_t nEntries;
+  Long64_t nextEntry;
+  
+  // generator parameters of the events
+  int          minMult;
+  int          maxMult;
+  double       kaonFraction;
+  double       dccFraction;
+  unsigned int seed;
+  int          entrySize;
+  
+  // events of the current entry, the next
+  // one to read is nextEvent
+  int        n;
+  int        nextEvent;
+  double   * centrality;
+  UShort_t * k;
+  UShort_t * k0;
+  UShort_t * k0s;
+  UShort_t * k_DCC;
+  UShort_t * k0_DCC;
+  UShort_t * k0s_DCC;
+  
+  KaonEventReader(const TString & fileName)
+  {
+  tree       = 0;
+  nEntries   = 0;
+  nextEntry  = 0;
+  n          = 0;
+  nextEvent  = 0;
+  centrality = 0;
+  k          = 0;
+  k0         = 0;
+  k0s        = 0;
+  k_DCC      = 0;
+  k0_DCC     = 0;
+  k0s_DCC    = 0;
+  file = TFile::Open(fileName);
+  if (!file || file->IsZombie())
+    {
+    cout << "-E- KaonEventReader(...) Cannot open file:" << fileName << endl;
+    delete file;
+    file = 0;
+    return;
+    }
+  TVectorD * parameters = (TVectorD *) file->Get("generator");
+  tree = (TTree *) file->Get("events");
+  if (!parameters || !tree || parameters->GetNrows()<6)
+    {
+    cout << "-E- KaonEventReader(...) " << fileName << " is not a KaonEventWriter file" << endl;
+    delete parameters;
+    tree = 0;
+    return;
+    }
+  minMult      = int((*parameters)[0]);
+  maxMult      = int((*parameters)[1]);
+  kaonFraction = (*parameters)[2];
+  dccFraction  = (*parameters)[3];
+  seed         = (unsigned int) (*parameters)[4];
+  entrySize    = int((*parameters)[5]);
+  delete parameters;
+  
+  centrality = new double[entrySize];
+  k          = new UShort_t[entrySize];
+  k0         = new UShort_t[entrySize];
+  k0s        = new UShort_t[entrySize];
+  k_DCC      = new UShort_t[entrySize];
+  k0_DCC     = new UShort_t[entrySize];
+  k0s_DCC    = new UShort_t[entrySize];
+  
+  nEntries = tree->GetEntries();
+  tree->SetBranchAddress("n",          &n);
+  tree->SetBranchAddress("centrality", centrality);
+  tree->SetBranchAddress("k",          k);
+  tree->SetBranchAddress("k0",         k0);
+  tree->SetBranchAddress("k0s",        k0s);
+  tree->SetBranchAddress("k_DCC",      k_DCC);
+  tree->SetBranchAddress("k0_DCC",     k0_DCC);
+  tree->SetBranchAddress("k0s_DCC",    k0s_DCC);
+  tree->SetCacheSize(64*1024*1024);
+  tree->AddBranchToCache("*", true);
+  }
+  
+  ~KaonEventReader()
+  {
+  if (file)
+    {
+    file->Close();
+    delete file;
+    }
+  delete [] centrality;
+  delete [] k;
+  delete [] k0;
+  delete [] k0s;
+  delete [] k_DCC;
+  delete [] k0_DCC;
+  delete [] k0s_DCC;
+  }
+  
+  bool isOpen() const
+  {
+  return tree!=0;
+  }
+  
+  ////////////////////////////////////////////
+  // Fill batch with the next events, up to
+  // its capacity. Returns the number of
+  // events read, 0 at the end of the file.
+  ////////////////////////////////////////////
+  int read(KaonEventBatch & batch)
+  {
+  if (!tree) return 0;
+  int nRead = 0;
+  while (nRead<batch.capacity)
+    {
+    if (nextEvent==n)
+      {
+      if (nextEntry>=nEntries) break;
+      tree->GetEntry(nextEntry++);
+      nextEvent = 0;
+      continue;
+      }
+    int m = n - nextEvent;
+    if (m>batch.capacity-nRead) m = batch.capacity - nRead;
+    std::copy(centrality+nextEvent, centrality+nextEvent+m, batch.centrality+nRead);
+    std::copy(k+nextEvent,          k+nextEvent+m,          batch.k+nRead);
+    std::copy(k0+nextEvent,         k0+nextEvent+m,         batch.k0+nRead);
+    std::copy(k0s+nextEvent,        k0s+nextEvent+m,        batch.k0s+nRead);
+    std::copy(k_DCC+nextEvent,      k_DCC+nextEvent+m,      batch.k_DCC+nRead);
+    std::copy(k0_DCC+nextEvent,     k0_DCC+nextEvent+m,     batch.k0_DCC+nRead);
+    std::copy(k0s_DCC+nextEvent,    k0s_DCC+nextEvent+m,    batch.k0s_DCC+nRead);
+    nextEvent += m;
+    nRead     += m;
+    }
+  for (int i=0; i<nRead; i++)
+    {
+    batch.kc[i]           = batch.k[i]   - batch.k0[i];
+    batch.kc_DCC[i]       = batch.k_DCC[i] - batch.k0_DCC[i];
+    batch.k_Binomial[i]   = batch.k[i]   - batch.k_DCC[i];
+    batch.k0_Binomial[i]  = batch.k0[i]  - batch.k0_DCC[i];
+    batch.k0s_Binomial[i] = batch.k0s[i] - batch.k0s_DCC[i];
+    batch.kc_Binomial[i]  = batch.k_Binomial[i] - batch.k0_Binomial[i];
+    batch.k0Fraction_DCC[i] = 0.0;
+    }
+  batch.nEvents = nRead;
+  return nRead;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Accumulated real and cpu time, calls and
+// events of the stages of a simulator. The
+// cpu time is that of the calling thread
+// (CLOCK_THREAD_CPUTIME_ID), in ns rather
+// than the 10 ms ticks of the process wide
+// TStopwatch::CpuTime(), so that short
+// per-batch samples and simulators running
+// on concurrent threads add up correctly.
+////////////////////////////////////////////
+class KaonStageTimers
+{
+public:
+  
+  enum { generate=0, fill, eventIO, checkpoint, moments, plot, nStages };
+  
+  double     realTime[nStages];
+  double     cpuTime[nStages];
+  long long  nCalls[nStages];
+  long long  nEvents[nStages];
+  // clock readings at start(stage)
+  double     realStart[nStages];
+  double     cpuStart[nStages];
+  
+  KaonStageTimers()
+  {
+  reset();
+  }
+  
+  void reset()
+  {
+  for (int k=0; k<nStages; k++)
+    {
+    realTime[k]  = 0.0;
+    cpuTime[k]   = 0.0;
+    nCalls[k]    = 0;
+    nEvents[k]   = 0;
+    realStart[k] = 0.0;
+    cpuStart[k]  = 0.0;
+    }
+  }
+  
+  static const char * stageName(int stage)
+  {
+  static const char * names[nStages] = { "generate", "fill", "eventIO", "checkpoint", "moments", "plot" };
+  return names[stage];
+  }
+  
+  // clock in seconds
+  static double readClock(clockid_t clockId)
+  {
+  timespec t;
+  clock_gettime(clockId, &t);
+  return t.tv_sec + 1.0e-9*t.tv_nsec;
+  }
+  
+  void start(int stage)
+  {
+  realStart[stage] = readClock(CLOCK_MONOTONIC);
+  cpuStart[stage]  = readClock(CLOCK_THREAD_CPUTIME_ID);
+  }
+  
+  void stop(int stage, long long n=0)
+  {
+  cpuTime[stage]  += readClock(CLOCK_THREAD_CPUTIME_ID) - cpuStart[stage];
+  realTime[stage] += readClock(CLOCK_MONOTONIC) - realStart[stage];
+  nCalls[stage]++;
+  nEvents[stage]  += n;
+  }
+  
+  void add(const KaonStageTimers & other)
+  {
+  for (int k=0; k<nStages; k++)
+    {
+    realTime[k] += other.realTime[k];
+    cpuTime[k]  += other.cpuTime[k];
+    nCalls[k]   += other.nCalls[k];
+    nEvents[k]  += other.nEvents[k];
+    }
+  }
+  
+  void print(ostream & os)
+  {
+  double total = 0.0;
+  for (int k=0; k<nStages; k++) total += realTime[k];
+  os << "----------------------------------------------------" << endl;
+  os << "      stage     real(s)      cpu(s)  share     calls       events     events/s" << endl;
+  for (int k=0; k<nStages; k++)
+    {
+    if (nCalls[k]==0) continue;
+    os << setw(11) << stageName(k)
+       << setw(12) << realTime[k]
+       << setw(12) << cpuTime[k]
+       << setw(6)  << int(100.0*realTime[k]/total + 0.5) << "%"
+       << setw(10) << nCalls[k]
+       << setw(13) << nEvents[k];
+    if (nEvents[k]>0 && realTime[k]>0.0) os << setw(13) << nEvents[k]/realTime[k];
+    os << endl;
+    }
+  }
+  
+};
+
+class KaonDccSimulator
+{
+public:
+  
+  ////////////////////////////////////////////
+  // Data members
+  ////////////////////////////////////////////
+  KaonEvent      * kaonEvent;
+  KaonEventBatch * kaonEventBatch;
+  KaonGenerator  * kaonGenerator;
+  KaonMoments   * kaonMoments;
+  bool debug;
+  unsigned int seed;
+  int  batchSize;
+  // events are generated in whole batches on a
+  // fixed grid, see generateEvents();
+  // batchRandom is the generator state at the
+  // start of the batch in kaonEventBatch
+  bool       batchValid;
+  TRandom3 * batchRandom;
+  
+  // seeds of all the event streams in
+  // kaonMoments (several after merging)
+  std::vector<unsigned int> seeds;
+  // false once states of other jobs have been
+  // merged in: the generator state then no
+  // longer describes the accumulated events
+  bool resumable;
+  
+  // optional event output, see setEventOutput()
+  KaonEventWriter * eventWriter;
+  
+  // periodic checkpoints, see setCheckpoint()
+  TString checkpointFileName;
+  int     checkpointEvents;
+  int     nextCheckpoint;
+  
+  // time spent in each stage, see run()
+  KaonStageTimers timers;
+  
+  ////////////////////////////////////////////
+  // CTOR
+  ////////////////////////////////////////////
+  KaonDccSimulator(double kaonFraction = 0.3,
+                   double dccFraction = 0.9,
+                   int minMult=1,
+                   int maxMult=200,
+                   bool debugOption=false,
+                   unsigned int aSeed=4357)
+  {
+  cout << "-I- KaonDccSimulator(...) Setting up simulator for ..." << endl;
+  cout << "    kaonFraction : " << kaonFraction << endl;
+  cout << "    dccFraction : " << dccFraction << endl;
+  cout << "        minMult : " << minMult << endl;
+  cout << "        maxMult : " << maxMult << endl;
+  cout << "    debugOption : " << debugOption << endl;
+  cout << "           seed : " << aSeed << endl;
+
+  debug = debugOption;
+  seed  = aSeed;
+  seeds.push_back(seed);
+  resumable        = true;
+  eventWriter      = 0;
+  checkpointEvents = 0;
+  nextCheckpoint   = 0;
+  
+  batchSize      = 8192;
+  kaonEvent      = new KaonEvent();
+  kaonEventBatch = new KaonEventBatch(batchSize);
+  kaonGenerator = new KaonGenerator(minMult,maxMult, kaonFraction, dccFraction, seed);
+  kaonMoments   = new KaonMoments(makeBaseName(kaonFraction, dccFraction, minMult, maxMult),400, 0.0, 400.0);
+  batchValid     = false;
+  batchRandom    = new TRandom3(seed);
+ 
+  }
+  
+  ////////////////////////////////////////////
+  // Histogram name prefix of a model point
+  ////////////////////////////////////////////
+  static TString makeBaseName(double kaonFraction, double dccFraction, int minMult, int maxMult)
+  {
+  TString baseName;
+  
+  baseName += "Kaonf=0.";
+  baseName += int(100*kaonFraction);
+  baseName += "_";
+  
+  baseName += "DCCf=0.";
+  baseName += int(100*dccFraction);
+  baseName += "_";
+  baseName += minMult;
+  baseName += "M";
+  baseName += maxMult;
+  baseName += "_";
+  return baseName;
+  }
+  
+  ////////////////////////////////////////////
+  // DTOR
+  ////////////////////////////////////////////
+  ~KaonDccSimulator()
+  {
+  delete eventWriter;
+  delete batchRandom;
+  delete kaonEvent;
+  delete kaonEventBatch;
+  delete kaonGenerator;
+  delete kaonMoments;
+  }
+  
+  ////////////////////////////////////////////
+  // run simulator
+  // headless: no canvases (nor pdf files)
+  ////////////////////////////////////////////
+  void run(int nEventsRequested, bool headless=false)
+  {
+  cout << "-I- run(int nEventsRequested) Generating nEvents:" << nEventsRequested << endl;
+  simulate(nEventsRequested);
+  kaonMoments->print(cout);
+  if (!headless) plotHistograms();
+  timers.print(cout);
+  cout << "-I- run(int nEventsRequested) Done" << endl;
+  }
+  
+  void plotHistograms()
+  {
+  timers.start(KaonStageTimers::plot);
+  kaonMoments->plotHistograms();
+  timers.stop(KaonStageTimers::plot);
+  }
+  
+  ////////////////////////////////////////////
+  // Generate and accumulate events until
+  // nEventsRequested events are accumulated,
+  // then calculate the moments. Counting
+  // restored events means a simulator resumed
+  // from a checkpoint only generates the
+  // missing ones. No printing or plotting:
+  // safe to call from a worker thread as long
+  // as each thread owns its simulator.
+  ////////////////////////////////////////////
+  void simulate(int nEventsRequested)
+  {
+  chooseBatchSize(nEventsRequested);
+  generateEvents(nEventsRequested - kaonMoments->nEvents);
+  if (checkpointEvents>0) writeCheckpoint();
+  closeEventOutput();
+  calculateMoments();
+  }
+  
+  void calculateMoments()
+  {
+  timers.start(KaonStageTimers::moments);
+  kaonMoments->calculateMoments();
+  timers.stop(KaonStageTimers::moments);
+  }
+  
+  void closeEventOutput()
+  {
+  if (!eventWriter) return;
+  timers.start(KaonStageTimers::eventIO);
+  eventWriter->close();
+  timers.stop(KaonStageTimers::eventIO);
+  }
+  
+  ////////////////////////////////////////////
+  // Also write the generated events to
+  // fileName (see KaonEventWriter). The file
+  // is closed at the end of simulate(); it
+  // only holds events generated after this
+  // call, so not those restored by resume().
+  ////////////////////////////////////////////
+  void setEventOutput(const TString & fileName)
+  {
+  delete eventWriter;
+  eventWriter = new KaonEventWriter(fileName, *kaonGenerator);
+  }
+  
+  ////////////////////////////////////////////
+  // Fill kaonMoments with the events saved in
+  // fileName instead of generating them, then
+  // calculate the moments. nEventsRequested<0
+  // replays all events.
+  ////////////////////////////////////////////
+  bool replay(const TString & fileName, int nEventsRequested=-1)
+  {
+  KaonEventReader reader(fileName);
+  if (!reader.isOpen()) return false;
+  // kaonEventBatch is reused for the replayed events
+  batchValid = false;
+  if (reader.minMult!=kaonGenerator->minMult || reader.maxMult!=kaonGenerator->maxMult ||
+      reader.kaonFraction!=kaonGenerator->kaonFraction || reader.dccFraction!=kaonGenerator->dccFraction)
+    cout << "-W- replay(...) Events in " << fileName << " were generated with other parameters" << endl;
+  
+  int n;
+  while (true)
+    {
+    timers.start(KaonStageTimers::eventIO);
+    n = reader.read(*kaonEventBatch);
+    timers.stop(KaonStageTimers::eventIO, n);
+    if (n==0) break;
+    if (nEventsRequested>=0 && kaonMoments->nEvents+n>nEventsRequested)
+      {
+      kaonEventBatch->nEvents = nEventsRequested - kaonMoments->nEvents;
+      n = kaonEventBatch->nEvents;
+      }
+    timers.start(KaonStageTimers::fill);
+    kaonMoments->fill(*kaonEventBatch);
+    timers.stop(KaonStageTimers::fill, n);
+    if (nEventsRequested>=0 && kaonMoments->nEvents>=nEventsRequested) break;
+    }
+  calculateMoments();
+  return true;
+  }
+  
+  ////////////////////////////////////////////
+  // Batch size for a run of nEventsTotal
+  // events: at most the batch capacity, with
+  // nEventsTotal split evenly over the
+  // batches, so that a short run does not
+  // draw a whole batch it does not use. Set
+  // before the first event only: the grid of
+  // generateEvents() must not move during a
+  // run; resume() restores it.
+  ////////////////////////////////////////////
+  void chooseBatchSize(int nEventsTotal)
+  {
+  if (kaonMoments->nEvents>0 || nEventsTotal<1) return;
+  int capacity = kaonEventBatch->capacity;
+  int nBatches = (nEventsTotal + capacity - 1)/capacity;
+  batchSize  = (nEventsTotal + nBatches - 1)/nBatches;
+  batchValid = false;
+  }
+  
+  ////////////////////////////////////////////
+  // Generate and accumulate nEventsRequested
+  // more events. Events are generated in whole
+  // batches on a fixed grid (event i belongs
+  // to batch i/batchSize); the rest of a batch
+  // only partly used is kept for the next
+  // call. The events thus only depend on the
+  // seed and batchSize (chosen for the first
+  // request, saved with the state), not on how
+  // the run is split into calls, adaptive
+  // chunks or resumed jobs.
+  ////////////////////////////////////////////
+  void generateEvents(int nEventsRequested)
+  {
+  int iEvent = 0;
+  while (iEvent<nEventsRequested)
+    {
+    // position of the next event in its batch
+    int first = kaonMoments->nEvents % batchSize;
+    if (first==0 || !batchValid)
+      {
+      *batchRandom = *kaonGenerator->random;
+      timers.start(KaonStageTimers::generate);
+      kaonGenerator->generate(*kaonEventBatch, batchSize);
+      timers.stop(KaonStageTimers::generate, batchSize);
+      batchValid = true;
+      }
+    int n = batchSize - first;
+    if (n>nEventsRequested-iEvent) n = nEventsRequested - iEvent;
+    if (eventWriter)
+      {
+      timers.start(KaonStageTimers::eventIO);
+      eventWriter->write(*kaonEventBatch, first, n);
+      timers.stop(KaonStageTimers::eventIO, n);
+      }
+    timers.start(KaonStageTimers::fill);
+    kaonMoments->fill(*kaonEventBatch, first, n);
+    timers.stop(KaonStageTimers::fill, n);
+    iEvent += n;
+    // debug: print every event, same events as without debug
+    if (debug)
+      {
+      for (int i=first; i<first+n; i++)
+        {
+        kaonEventBatch->getEvent(i, *kaonEvent);
+        kaonEvent->print(cout);
+        }
+      }
+    checkpointIfDue();
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // Generator state to restart from: the state
+  // at the start of the batch of the next
+  // event, from which resume() generates that
+  // batch again
+  ////////////////////////////////////////////
+  TRandom3 * restartRandom()
+  {
+  if (batchValid && kaonMoments->nEvents % batchSize != 0) return batchRandom;
+  return kaonGenerator->random;
+  }
+  
+  ////////////////////////////////////////////
+  // Save the state to fileName every
+  // everyNEvents events (at batch boundaries)
+  // and at the end of simulate(). A killed
+  // job restarts with resume(fileName).
+  ////////////////////////////////////////////
+  void setCheckpoint(const TString & fileName, int everyNEvents)
+  {
+  checkpointFileName = fileName;
+  checkpointEvents   = everyNEvents;
+  nextCheckpoint     = kaonMoments->nEvents + checkpointEvents;
+  }
+  
+  void checkpointIfDue()
+  {
+  if (checkpointEvents<=0 || kaonMoments->nEvents<nextCheckpoint) return;
+  writeCheckpoint();
+  }
+  
+  ////////////////////////////////////////////
+  // Write to a temporary file first so that a
+  // job killed while writing leaves the
+  // previous checkpoint intact
+  ////////////////////////////////////////////
+  void writeCheckpoint()
+  {
+  timers.start(KaonStageTimers::checkpoint);
+  TString tmpName = checkpointFileName + ".tmp";
+  if (saveState(tmpName)) gSystem->Rename(tmpName, checkpointFileName);
+  nextCheckpoint = kaonMoments->nEvents + checkpointEvents;
+  timers.stop(KaonStageTimers::checkpoint);
+  }
+  
+  ////////////////////////////////////////////
+  // Generator parameters and batch size,
+  // seeds, generator random state and the
+  // KaonMoments state
+  ////////////////////////////////////////////
+  bool saveState(const TString & fileName)
+  {
+  TFile * file = TFile::Open(fileName, "RECREATE");
+  if (!file || file->IsZombie())
+    {
+    cout << "-E- saveState(...) Cannot open file:" << fileName << endl;
+    delete file;
+    return false;
+    }
+  saveState(file);
+  file->Close();
+  delete file;
+  return true;
+  }
+  
+  void saveState(TDirectory * dir)
+  {
+  TVectorD generator(5);
+  generator[0] = kaonGenerator->minMult;
+  generator[1] = kaonGenerator->maxMult;
+  generator[2] = kaonGenerator->kaonFraction;
+  generator[3] = kaonGenerator->dccFraction;
+  generator[4] = batchSize;
+  dir->WriteTObject(&generator, "generator");
+  TVectorD seedList(seeds.size());
+  for (unsigned int k=0; k<seeds.size(); k++) seedList[k] = seeds[k];
+  dir->WriteTObject(&seedList, "seeds");
+  if (resumable) dir->WriteTObject(restartRandom(), "random");
+  kaonMoments->saveState(dir);
+  }
+  
+  ////////////////////////////////////////////
+  // True if the state in dir was produced
+  // with the same generator parameters
+  ////////////////////////////////////////////
+  bool isCompatible(TDirectory * dir)
+  {
+  TVectorD * generator = (TVectorD *) dir->Get("generator");
+  if (!generator) return false;
+  bool compatible = (*generator)[0]==kaonGenerator->minMult &&
+                    (*generator)[1]==kaonGenerator->maxMult &&
+                    (*generator)[2]==kaonGenerator->kaonFraction &&
+                    (*generator)[3]==kaonGenerator->dccFraction;
+  delete generator;
+  return compatible;
+  }
+  
+  ////////////////////////////////////////////
+  // Continue from a state saved by this
+  // configuration (same parameters and seed):
+  // restores the accumulated events and the
+  // random generator. Returns false, leaving
+  // the simulator untouched, if there is no
+  // usable state in fileName.
+  ////////////////////////////////////////////
+  bool resume(const TString & fileName)
+  {
+  if (gSystem->AccessPathName(fileName))
+    {
+    cout << "-I- resume(...) No checkpoint " << fileName << " -- Starting from scratch" << endl;
+    return false;
+    }
+  TFile * file = TFile::Open(fileName);
+  if (!file || file->IsZombie())
+    {
+    cout << "-E- resume(...) Cannot open file:" << fileName << endl;
+    delete file;
+    return false;
+    }
+  bool resumed = false;
+  TVectorD * seedList = (TVectorD *) file->Get("seeds");
+  TObject  * randomObject = file->Get("random");
+  TRandom3 * random   = dynamic_cast<TRandom3 *>(randomObject);
+  if (!random) delete randomObject;
+  if (!isCompatible(file) || !seedList || seedList->GetNrows()!=1 || (unsigned int) (*seedList)[0]!=seed || !random)
+    {
+    cout << "-E- resume(...) " << fileName << " was not written by this configuration -- Not resumed" << endl;
+    delete random;
+    }
+  else if (kaonMoments->loadState(file))
+    {
+    delete kaonGenerator->random;
+    kaonGenerator->random = random;
+    // batch grid of the saved run (8192 in
+    // states without it)
+    TVectorD * generator = (TVectorD *) file->Get("generator");
+    batchSize = 8192;
+    if (generator->GetNrows()>4) batchSize = int((*generator)[4]);
+    if (batchSize<1 || batchSize>kaonEventBatch->capacity) batchSize = kaonEventBatch->capacity;
+    delete generator;
+    batchValid = false;
+    nextCheckpoint = kaonMoments->nEvents + checkpointEvents;
+    resumed = true;
+    cout << "-I- resume(...) Resumed from " << fileName << " with nEvents:" << kaonMoments->nEvents << endl;
+    }
+  else
+    {
+    delete random;
+    }
+  delete seedList;
+  file->Close();
+  delete file;
+  return resumed;
+  }
+  
+  ////////////////////////////////////////////
+  // Add the events saved in fileName by
+  // another job for the same scan point
+  ////////////////////////////////////////////
+  bool addState(const TString & fileName)
+  {
+  TFile * file = TFile::Open(fileName);
+  if (!file || file->IsZombie())
+    {
+    cout << "-E- addState(...) Cannot open file:" << fileName << endl;
+    delete file;
+    return false;
+    }
+  bool added = false;
+  TVectorD * seedList = (TVectorD *) file->Get("seeds");
+  if (!isCompatible(file) || !seedList)
+    {
+    cout << "-E- addState(...) " << fileName << " has different generator parameters -- Not added" << endl;
+    }
+  else
+    {
+    KaonMoments * other = new KaonMoments(kaonMoments->baseName, kaonMoments->nBinsKmult, kaonMoments->minKmult, kaonMoments->maxKmult);
+    if (other->loadState(file) && kaonMoments->add(*other))
+      {
+      for (int k=0; k<seedList->GetNrows(); k++)
+        {
+        unsigned int s = (unsigned int) (*seedList)[k];
+        for (unsigned int j=0; j<seeds.size(); j++)
+          if (seeds[j]==s) cout << "-W- addState(...) Seed " << s << " already merged -- Events are duplicated" << endl;
+        seeds.push_back(s);
+        }
+      resumable  = false;
+      // the merged events move the batch grid
+      batchValid = false;
+      added = true;
+      }
+    delete other;
+    }
+  delete seedList;
+  file->Close();
+  delete file;
+  return added;
+  }
+  
+  ////////////////////////////////////////////
+  // Merge the states saved by several jobs
+  // for one scan point, calculate the moments
+  // of the combined sample and optionally save
+  // the merged state (which can be merged
+  // again, but not resumed).
+  ////////////////////////////////////////////
+  static KaonDccSimulator * mergeStates(const std::vector<TString> & fileNames,
+                                        const TString & outputFileName="")
+  {
+  if (fileNames.empty()) return 0;
+  TFile * file = TFile::Open(fileNames[0]);
+  TVectorD * generator = (file && !file->IsZombie()) ? (TVectorD *) file->Get("generator") : 0;
+  if (!generator)
+    {
+    cout << "-E- mergeStates(...) Cannot read generator parameters from " << fileNames[0] << endl;
+    delete file;
+    return 0;
+    }
+  KaonDccSimulator * merged = new KaonDccSimulator((*generator)[2], (*generator)[3], int((*generator)[0]), int((*generator)[1]));
+  delete generator;
+  file->Close();
+  delete file;
+  
+  merged->seeds.clear();
+  for (unsigned int k=0; k<fileNames.size(); k++) merged->addState(fileNames[k]);
+  merged->resumable = false;
+  merged->kaonMoments->calculateMoments();
+  if (outputFileName.Length()>0) merged->saveState(outputFileName);
+  return merged;
+  }
+  
+  ////////////////////////////////////////////
+  // run simulator until nuDyn_ch0 and
+  // nuDyn_ch0s reach the requested precision
+  // (see KaonMoments::precisionReached) or
+  // maxEvents have been generated. The errors
+  // are updated every checkEvents events.
+  ////////////////////////////////////////////
+  void runAdaptive(double relativePrecision,
+                   double absolutePrecision,
+                   int    maxEvents,
+                   int    checkEvents=100000,
+                   bool   headless=false)
+  {
+  cout << "-I- runAdaptive(...) Generating up to nEvents:" << maxEvents << endl;
+  cout << "    relativePrecision : " << relativePrecision << endl;
+  cout << "    absolutePrecision : " << absolutePrecision << endl;
+  bool reached = simulateAdaptive(relativePrecision, absolutePrecision, maxEvents, checkEvents);
+  if (!reached)
+    cout << "-W- runAdaptive(...) Precision not reached with maxEvents:" << maxEvents << endl;
+  kaonMoments->print(cout);
+  if (!headless) plotHistograms();
+  timers.print(cout);
+  cout << "-I- runAdaptive(...) Done" << endl;
+  }
+  
+  ////////////////////////////////////////////
+  // Worker part of runAdaptive(): no printing
+  // or plotting. Returns true if the precision
+  // was reached.
+  ////////////////////////////////////////////
+  bool simulateAdaptive(double relativePrecision,
+                        double absolutePrecision,
+                        int    maxEvents,
+                        int    checkEvents=100000)
+  {
+  if (checkEvents<kaonMoments->nSubsamples*2) checkEvents = kaonMoments->nSubsamples*2;
+  chooseBatchSize(maxEvents);
+  bool reached = false;
+  while (!reached && kaonMoments->nEvents<maxEvents)
+    {
+    int n = maxEvents - kaonMoments->nEvents;
+    if (n>checkEvents) n = checkEvents;
+    generateEvents(n);
+    calculateMoments();
+    reached = kaonMoments->precisionReached(relativePrecision, absolutePrecision);
+    }
+  if (checkpointEvents>0) writeCheckpoint();
+  closeEventOutput();
+  return reached;
+  }
+  
+  
+};
+
+////////////////////////////////////////////
+// One point of a parameter scan
+////////////////////////////////////////////
+class KaonScanPoint
+{
+public:
+  
+  double kaonFraction;
+  double dccFraction;
+  int    minMult;
+  int    maxMult;
+  int    nEventsRequested;
+  unsigned int seed;
+  // adaptive mode if either precision is > 0:
+  // nEventsRequested is then the maximum
+  double relativePrecision;
+  double absolutePrecision;
+  bool   precisionReached;
+  KaonDccSimulator * simulator;
+  
+  KaonScanPoint(double frac_kaon,
+                double frac_dcc,
+                int    min_Mult,
+                int    max_Mult,
+                int    nEvents,
+                unsigned int aSeed,
+                double relPrecision=0.0,
+                double absPrecision=0.0)
+  {
+  kaonFraction     = frac_kaon;
+  dccFraction      = frac_dcc;
+  minMult          = min_Mult;
+  maxMult          = max_Mult;
+  nEventsRequested = nEvents;
+  seed             = aSeed;
+  relativePrecision = relPrecision;
+  absolutePrecision = absPrecision;
+  precisionReached  = false;
+  simulator        = 0;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Run a grid of scan points on a pool of
+// threads. Points are dealt round-robin to
+// per-worker queues; a worker takes from the
+// back of its own queue and, once it is
+// empty, steals from the front of the others.
+// Every point owns its simulator and its
+// TRandom3 stream, seeded from baseSeed and
+// the point index only, so the results do not
+// depend on the number of threads.
+////////////////////////////////////////////
+class KaonScanScheduler
+{
+public:
+  
+  ////////////////////////////////////////////
+  // Data members
+  ////////////////////////////////////////////
+  int          nThreads;
+  unsigned int baseSeed;
+  // if set, every point resumes from and
+  // checkpoints to checkpointFileName(index)
+  TString      checkpointPrefix;
+  int          checkpointEvents;
+  std::vector<KaonScanPoint> points;
+  std::vector< std::deque<int> > queues;
+  std::vector<std::mutex *>      queueMutexes;
+  // wall clock time of the last run()
+  double       realTime;
+  
+  ////////////////////////////////////////////
+  // CTOR
+  // nThreadsRequested <= 0 : use all cores
+  ////////////////////////////////////////////
+  KaonScanScheduler(int nThreadsRequested=0,
+                    unsigned int aBaseSeed=4357)
+  {
+  nThreads = nThreadsRequested;
+  if (nThreads<=0) nThreads = std::thread::hardware_concurrency();
+  if (nThreads<=0) nThreads = 1;
+  baseSeed = aBaseSeed;
+  checkpointEvents = 0;
+  realTime = 0.0;
+  }
+  
+  void setCheckpoints(const TString & prefix, int everyNEvents)
+  {
+  checkpointPrefix = prefix;
+  checkpointEvents = everyNEvents;
+  }
+  
+  ////////////////////////////////////////////
+  // checkpointPrefix + baseName + point index
+  // and seed: baseName alone rounds the
+  // fractions to percent, so distinct points
+  // could share it
+  ////////////////////////////////////////////
+  TString checkpointFileName(int index)
+  {
+  const KaonScanPoint & point = points[index];
+  TString fileName = checkpointPrefix;
+  fileName += KaonDccSimulator::makeBaseName(point.kaonFraction, point.dccFraction, point.minMult, point.maxMult);
+  fileName += "point";
+  fileName += index;
+  fileName += "_seed";
+  fileName += point.seed;
+  fileName += ".root";
+  return fileName;
+  }
+  
+  ////////////////////////////////////////////
+  // DTOR
+  ////////////////////////////////////////////
+  ~KaonScanScheduler()
+  {
+  for (unsigned int k=0; k<points.size(); k++) delete points[k].simulator;
+  for (unsigned int k=0; k<queueMutexes.size(); k++) delete queueMutexes[k];
+  }
+  
+  ////////////////////////////////////////////
+  // Deterministic per-point seed (splitmix64
+  // finalizer). Never returns 0, which would
+  // make TRandom3 seed itself from the clock.
+  ////////////////////////////////////////////
+  static unsigned int pointSeed(unsigned int base, int index)
+  {
+  unsigned long long z = (((unsigned long long) base) << 32) + (unsigned long long) index;
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z =  z ^ (z >> 31);
+  unsigned int s = (unsigned int) (z ^ (z >> 32));
+  return (s==0) ? 1 : s;
+  }
+  
+  ////////////////////////////////////////////
+  // Add a point to the grid, returns its index
+  ////////////////////////////////////////////
+  int addPoint(double kaonFraction,
+               double dccFraction,
+               int    minMult,
+               int    maxMult,
+               int    nEventsRequested,
+               double relativePrecision=0.0,
+               double absolutePrecision=0.0)
+  {
+  int index = points.size();
+  points.push_back(KaonScanPoint(kaonFraction, dccFraction, minMult, maxMult, nEventsRequested, pointSeed(baseSeed,index),
+                                 relativePrecision, absolutePrecision));
+  return index;
+  }
+  
+  ////////////////////////////////////////////
+  // The scheduler owns the simulators of its
+  // points and deletes them with itself;
+  // releaseSimulator() hands one over to the
+  // caller, who must then delete it.
+  ////////////////////////////////////////////
+  KaonDccSimulator * getSimulator(int index)
+  {
+  return points[index].simulator;
+  }
+  
+  KaonDccSimulator * releaseSimulator(int index)
+  {
+  KaonDccSimulator * simulator = points[index].simulator;
+  points[index].simulator = 0;
+  return simulator;
+  }
+  
+  ////////////////////////////////////////////
+  // Next point for worker iWorker, -1 when
+  // no work is left anywhere
+  ////////////////////////////////////////////
+  int nextPoint(int iWorker)
+  {
+  int nQueues = queues.size();
+  for (int k=0; k<nQueues; k++)
+    {
+    int iQueue = (iWorker+k) % nQueues;
+    std::lock_guard<std::mutex> lock(*queueMutexes[iQueue]);
+    if (queues[iQueue].empty()) continue;
+    int index;
+    if (k==0)
+      {
+      index = queues[iQueue].back();
+      queues[iQueue].pop_back();
+      }
+    else
+      {
+      index = queues[iQueue].front();
+      queues[iQueue].pop_front();
+      }
+    return index;
+    }
+  return -1;
+  }
+  
+  void work(int iWorker)
+  {
+  int index;
+  while ((index = nextPoint(iWorker)) >= 0)
+    {
+    KaonScanPoint & point = points[index];
+    if (point.relativePrecision>0.0 || point.absolutePrecision>0.0)
+      point.precisionReached = point.simulator->simulateAdaptive(point.relativePrecision, point.absolutePrecision, point.nEventsRequested);
+    else
+      point.simulator->simulate(point.nEventsRequested);
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // Run all points. Simulators (and their
+  // histograms) are created here on the
+  // calling thread; workers only generate
+  // and accumulate.
+  ////////////////////////////////////////////
+  void run()
+  {
+  int nPoints = points.size();
+  int nWorkers = (nThreads<nPoints) ? nThreads : nPoints;
+  if (nWorkers<1) return;
+  cout << "-I- KaonScanScheduler::run() Running " << nPoints << " points on " << nWorkers << " thread(s)" << endl;
+  TStopwatch stopwatch;
+  
+  // two points must never write the same file
+  if (checkpointEvents>0)
+    {
+    std::vector<TString> fileNames;
+    for (int k=0; k<nPoints; k++) fileNames.push_back(checkpointFileName(k));
+    for (int k=0; k<nPoints; k++)
+      for (int j=0; j<k; j++)
+        if (fileNames[k]==fileNames[j])
+          {
+          cout << "-E- KaonScanScheduler::run() Points " << j << " and " << k << " share the checkpoint file " << fileNames[k] << " -- Not run" << endl;
+          return;
+          }
+    }
+  
+  for (int k=0; k<nPoints; k++)
+    {
+    KaonScanPoint & point = points[k];
+    if (!point.simulator)
+      {
+      point.simulator = new KaonDccSimulator(point.kaonFraction, point.dccFraction, point.minMult, point.maxMult, false, point.seed);
+      if (checkpointEvents>0)
+        {
+        TString fileName = checkpointFileName(k);
+        point.simulator->resume(fileName);
+        point.simulator->setCheckpoint(fileName, checkpointEvents);
+        }
+      }
+    }
+  
+  for (unsigned int k=0; k<queueMutexes.size(); k++) delete queueMutexes[k];
+  queues.assign(nWorkers, std::deque<int>());
+  queueMutexes.assign(nWorkers, (std::mutex *) 0);
+  for (int k=0; k<nWorkers; k++) queueMutexes[k] = new std::mutex();
+  for (int k=0; k<nPoints; k++) queues[k % nWorkers].push_back(k);
+  
+  if (nWorkers==1)
+    {
+    work(0);
+    }
+  else
+    {
+    ROOT::EnableThreadSafety();
+    std::vector<std::thread> workers;
+    for (int k=0; k<nWorkers; k++) workers.push_back(std::thread(&KaonScanScheduler::work, this, k));
+    for (int k=0; k<nWorkers; k++) workers[k].join();
+    }
+  realTime = stopwatch.RealTime();
+  cout << "-I- KaonScanScheduler::run() Done" << endl;
+  }
+  
+  ////////////////////////////////////////////
+  // Events used and nuDyn with errors for
+  // every point
+  ////////////////////////////////////////////
+  void print(ostream & os)
+  {
+  os << "----------------------------------------------------" << endl;
+  os << " point  kaonF   dccF  minMult maxMult    nEvents   nuDyn_ch0 +- err   nuDyn_ch0s +- err" << endl;
+  for (unsigned int k=0; k<points.size(); k++)
+    {
+    KaonScanPoint & point = points[k];
+    if (!point.simulator) continue;
+    KaonMoments * moments = point.simulator->kaonMoments;
+    os << setw(6) << k
+       << setw(7) << point.kaonFraction
+       << setw(7) << point.dccFraction
+       << setw(9) << point.minMult
+       << setw(8) << point.maxMult
+       << setw(11) << moments->nEvents
+       << "   " << moments->nuDyn_ch0  << " +- " << moments->nuDyn_ch0_err
+       << "   " << moments->nuDyn_ch0s << " +- " << moments->nuDyn_ch0s_err;
+    if ((point.relativePrecision>0.0 || point.absolutePrecision>0.0) && !point.precisionReached)
+      os << "  (precision not reached)";
+    os << endl;
+    }
+  printTimers(os);
+  }
+  
+  ////////////////////////////////////////////
+  // Stage timers summed over the points (so
+  // over the threads: the cpu column is the
+  // total cpu time of the workers, the real
+  // column the sum of their busy times), and
+  // the scan throughput in accumulated events
+  // (the generate stage also counts the
+  // unused rest of partly used batches)
+  ////////////////////////////////////////////
+  void printTimers(ostream & os)
+  {
+  KaonStageTimers timers;
+  long long nEvents = 0;
+  for (unsigned int k=0; k<points.size(); k++)
+    {
+    if (!points[k].simulator) continue;
+    timers.add(points[k].simulator->timers);
+    nEvents += points[k].simulator->timers.nEvents[KaonStageTimers::fill];
+    }
+  timers.print(os);
+  os << " accumulated: " << nEvents << " events in " << realTime << " s";
+  if (realTime>0.0) os << "  (" << nEvents/realTime << " events/s)";
+  os << endl;
+  }
+  
+};
+
+////////////////////////////////////////////
+// Reusable barrier of nThreads threads
+// (std::barrier is C++20)
+////////////////////////////////////////////
+class KaonBarrier
+{
+public:
+  
+  std::mutex              mutex;
+  std::condition_variable condition;
+  int       nThreads;
+  int       nWaiting;
+  long long generation;
+  
+  KaonBarrier(int nThreadsOption)
+  {
+  nThreads   = nThreadsOption;
+  nWaiting   = 0;
+  generation = 0;
+  }
+  
+  void wait()
+  {
+  std::unique_lock<std::mutex> lock(mutex);
+  long long myGeneration = generation;
+  if (++nWaiting==nThreads)
+    {
+    nWaiting = 0;
+    generation++;
+    condition.notify_all();
+    return;
+    }
+  while (generation==myGeneration) condition.wait(lock);
+  }
+  
+};
+
+////////////////////////////////////////////
+// Scan of dccFraction on shared base events.
+// Centrality and total kaons (and, with
+// shareK0Fraction, the DCC neutral fraction)
+// are drawn once per event; every dccFraction
+// variant then only draws its own DCC and
+// binomial split, with its own random
+// generator, and fills its own KaonMoments.
+// The variants are thus correlated: their
+// differences, with errors from paired
+// subsamples (the same events go to the same
+// subsample of every variant), have a lower
+// variance than differences of independent
+// simulations. The gain is largest between
+// neighbouring DCC variants sharing the
+// neutral fraction draw, so by default each
+// variant is compared with the previous one;
+// against the pure binomial variant only the
+// centrality and k are common.
+// The base events are generated on the
+// calling thread, one batch ahead of the
+// split and fill of the variants, which run
+// on up to nThreads-1 worker threads.
+////////////////////////////////////////////
+class KaonSharedBaseScan
+{
+public:
+  
+  ////////////////////////////////////////////
+  // Data members
+  ////////////////////////////////////////////
+  double kaonFraction;
+  int    minMult;
+  int    maxMult;
+  bool   shareK0Fraction;
+  int    batchSize;
+  int    nVariants;
+  std::vector<double> dccFractions;
+  
+  KaonGenerator  * baseGenerator;
+  // double buffer: the base events of the
+  // next batch are generated while those of
+  // the current one are split
+  KaonEventBatch * baseBatch[2];
+  std::vector<KaonGenerator *>  generators;
+  std::vector<KaonEventBatch *> batches;
+  std::vector<KaonMoments *>    moments;
+  
+  // nuDyn(variant) - nuDyn(referenceVariant),
+  // or - nuDyn(variant-1) for previousVariant
+  enum { previousVariant = -1 };
+  int referenceVariant;
+  std::vector<double> dNuDyn_ch0;
+  std::vector<double> dNuDyn_ch0s;
+  std::vector<double> dNuDyn_ch0_err;
+  std::vector<double> dNuDyn_ch0s_err;
+  
+  int nThreads;
+  // base events and moments; the split and
+  // fill of variant k in variantTimers[k]
+  KaonStageTimers timers;
+  std::vector<KaonStageTimers> variantTimers;
+  
+  ////////////////////////////////////////////
+  // CTOR
+  // The base events use the seed
+  // pointSeed(aSeed, firstSeedIndex) of
+  // KaonScanScheduler, variant k the seed
+  // pointSeed(aSeed, firstSeedIndex+k+1). Next
+  // to a scheduler with the same base seed,
+  // firstSeedIndex must be past its points,
+  // so that no two streams coincide. The
+  // results do not depend on nThreads.
+  // nThreadsRequested <= 0 : use all cores
+  ////////////////////////////////////////////
+  KaonSharedBaseScan(double kaonF,
+                     int    min_Mult,
+                     int    max_Mult,
+                     const std::vector<double> & fractions,
+                     bool   shareK0FractionOption=true,
+                     unsigned int aSeed=4357,
+                     int    firstSeedIndex=0,
+                     int    nThreadsRequested=0)
+  {
+  cout << "-I- KaonSharedBaseScan(...) Setting up shared base scan for ..." << endl;
+  cout << "    kaonFraction : " << kaonF << endl;
+  cout << "        minMult : " << min_Mult << endl;
+  cout << "        maxMult : " << max_Mult << endl;
+  cout << "      nVariants : " << fractions.size() << endl;
+  cout << "shareK0Fraction : " << shareK0FractionOption << endl;
+  
+  kaonFraction    = kaonF;
+  minMult         = min_Mult;
+  maxMult         = max_Mult;
+  shareK0Fraction = shareK0FractionOption;
+  batchSize       = 8192;
+  dccFractions    = fractions;
+  nVariants       = dccFractions.size();
+  referenceVariant = previousVariant;
+  nThreads = nThreadsRequested;
+  if (nThreads<=0) nThreads = std::thread::hardware_concurrency();
+  if (nThreads<=0) nThreads = 1;
+  
+  baseGenerator = new KaonGenerator(minMult, maxMult, kaonFraction, 0.0, KaonScanScheduler::pointSeed(aSeed, firstSeedIndex));
+  baseBatch[0]  = new KaonEventBatch(batchSize);
+  baseBatch[1]  = new KaonEventBatch(batchSize);
+  for (int k=0; k<nVariants; k++)
+    {
+    generators.push_back(new KaonGenerator(minMult, maxMult, kaonFraction, dccFractions[k], KaonScanScheduler::pointSeed(aSeed, firstSeedIndex+k+1)));
+    batches.push_back(new KaonEventBatch(batchSize));
+    moments.push_back(new KaonMoments(KaonDccSimulator::makeBaseName(kaonFraction, dccFractions[k], minMult, maxMult), 400, 0.0, 400.0));
+    }
+  dNuDyn_ch0.assign(nVariants, 0.0);
+  dNuDyn_ch0s.assign(nVariants, 0.0);
+  dNuDyn_ch0_err.assign(nVariants, 0.0);
+  dNuDyn_ch0s_err.assign(nVariants, 0.0);
+  variantTimers.assign(nVariants, KaonStageTimers());
+  }
+  
+  ////////////////////////////////////////////
+  // DTOR
+  ////////////////////////////////////////////
+  ~KaonSharedBaseScan()
+  {
+  delete baseGenerator;
+  delete baseBatch[0];
+  delete baseBatch[1];
+  for (int k=0; k<nVariants; k++)
+    {
+    delete generators[k];
+    delete batches[k];
+    delete moments[k];
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // Generate and accumulate nEventsRequested
+  // more base events, for all variants. With
+  // several threads, in round r the calling
+  // thread generates base batch r while the
+  // workers split and fill batch r-1; a
+  // barrier ends every round.
+  ////////////////////////////////////////////
+  void generateEvents(int nEventsRequested)
+  {
+  if (nEventsRequested<=0) return;
+  int nBatches = (nEventsRequested + batchSize - 1)/batchSize;
+  int nWorkers = (nThreads-1<nVariants) ? nThreads-1 : nVariants;
+  if (nWorkers<1)
+    {
+    for (int iBatch=0; iBatch<nBatches; iBatch++)
+      {
+      generateBase(*baseBatch[0], batchEvents(iBatch, nEventsRequested));
+      generateVariants(0, 1, *baseBatch[0]);
+      }
+    return;
+    }
+  
+  ROOT::EnableThreadSafety();
+  KaonBarrier barrier(nWorkers+1);
+  std::vector<std::thread> workers;
+  for (int k=0; k<nWorkers; k++)
+    workers.push_back(std::thread(&KaonSharedBaseScan::work, this, k, nWorkers, nBatches, &barrier));
+  for (int iRound=0; iRound<=nBatches; iRound++)
+    {
+    if (iRound<nBatches) generateBase(*baseBatch[iRound%2], batchEvents(iRound, nEventsRequested));
+    barrier.wait();
+    }
+  for (int k=0; k<nWorkers; k++) workers[k].join();
+  }
+  
+  // events of batch iBatch of a request
+  int batchEvents(int iBatch, int nEventsRequested)
+  {
+  int n = nEventsRequested - iBatch*batchSize;
+  return (n>batchSize) ? batchSize : n;
+  }
+  
+  ////////////////////////////////////////////
+  // Centrality, total kaons and, if shared,
+  // the DCC neutral fractions of n events
+  ////////////////////////////////////////////
+  void generateBase(KaonEventBatch & base, int n)
+  {
+  timers.start(KaonStageTimers::generate);
+  baseGenerator->generateBase(base, n);
+  if (shareK0Fraction) baseGenerator->uniformKernel(base.k0Fraction_DCC, n, 0.0, 1.0);
+  timers.stop(KaonStageTimers::generate, n);
+  }
+  
+  ////////////////////////////////////////////
+  // Worker iWorker of generateEvents(): in
+  // round r it splits base batch r-1
+  ////////////////////////////////////////////
+  void work(int iWorker, int nWorkers, int nBatches, KaonBarrier * barrier)
+  {
+  for (int iRound=0; iRound<=nBatches; iRound++)
+    {
+    if (iRound>0) generateVariants(iWorker, nWorkers, *baseBatch[(iRound-1)%2]);
+    barrier->wait();
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // Split and fill the base events in base
+  // for the variants iWorker, iWorker+nWorkers,
+  // ... Each variant has its own generator,
+  // batch, moments and timers, so the workers
+  // share nothing but the (read only) base
+  // batch.
+  ////////////////////////////////////////////
+  void generateVariants(int iWorker, int nWorkers, const KaonEventBatch & base)
+  {
+  int n = base.nEvents;
+  for (int k=iWorker; k<nVariants; k+=nWorkers)
+    {
+    KaonEventBatch & batch = *batches[k];
+    variantTimers[k].start(KaonStageTimers::generate);
+    batch.nEvents = n;
+    std::copy(base.centrality, base.centrality+n, batch.centrality);
+    std::copy(base.k, base.k+n, batch.k);
+    if (shareK0Fraction) std::copy(base.k0Fraction_DCC, base.k0Fraction_DCC+n, batch.k0Fraction_DCC);
+    generators[k]->generateSplit(batch, shareK0Fraction);
+    variantTimers[k].stop(KaonStageTimers::generate);
+    variantTimers[k].start(KaonStageTimers::fill);
+    moments[k]->fill(batch);
+    variantTimers[k].stop(KaonStageTimers::fill, n);
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // Accumulate nEventsRequested base events,
+  // then calculate the moments and the
+  // differences
+  ////////////////////////////////////////////
+  void simulate(int nEventsRequested)
+  {
+  if (nVariants<1) return;
+  generateEvents(nEventsRequested - moments[0]->nEvents);
+  calculateMoments();
+  }
+  
+  ////////////////////////////////////////////
+  // As KaonDccSimulator::simulateAdaptive():
+  // stops once every variant reaches the
+  // precision. Returns true if it did.
+  ////////////////////////////////////////////
+  bool simulateAdaptive(double relativePrecision,
+                        double absolutePrecision,
+                        int    maxEvents,
+                        int    checkEvents=100000)
+  {
+  if (nVariants<1) return true;
+  if (checkEvents<moments[0]->nSubsamples*2) checkEvents = moments[0]->nSubsamples*2;
+  bool reached = false;
+  while (!reached && moments[0]->nEvents<maxEvents)
+    {
+    int n = maxEvents - moments[0]->nEvents;
+    if (n>checkEvents) n = checkEvents;
+    generateEvents(n);
+    calculateMoments();
+    reached = true;
+    for (int k=0; k<nVariants; k++)
+      if (!moments[k]->precisionReached(relativePrecision, absolutePrecision)) reached = false;
+    }
+  return reached;
+  }
+  
+  void calculateMoments()
+  {
+  timers.start(KaonStageTimers::moments);
+  for (int k=0; k<nVariants; k++) moments[k]->calculateMoments();
+  calculateDifferences();
+  timers.stop(KaonStageTimers::moments);
+  }
+  
+  ////////////////////////////////////////////
+  // nuDyn differences to referenceVariant, or
+  // to the previous variant (the neighbouring
+  // dccFraction) for previousVariant; errors
+  // from the subsample differences
+  ////////////////////////////////////////////
+  void setReferenceVariant(int k)
+  {
+  if (k!=previousVariant && (k<0 || k>=nVariants))
+    {
+    cout << "-E- setReferenceVariant(int k) No variant:" << k << endl;
+    return;
+    }
+  referenceVariant = k;
+  if (moments[0]->nEvents>=2) calculateDifferences();
+  }
+  
+  void calculateDifferences()
+  {
+  int nSubsamples = KaonMoments::nSubsamples;
+  double values_ch0[KaonMoments::nSubsamples];
+  double values_ch0s[KaonMoments::nSubsamples];
+  for (int k=0; k<nVariants; k++)
+    {
+    int iReference = (referenceVariant==previousVariant) ? k-1 : referenceVariant;
+    if (iReference<0)
+      {
+      dNuDyn_ch0[k]      = 0.0;
+      dNuDyn_ch0s[k]     = 0.0;
+      dNuDyn_ch0_err[k]  = 0.0;
+      dNuDyn_ch0s_err[k] = 0.0;
+      continue;
+      }
+    KaonMoments * reference = moments[iReference];
+    dNuDyn_ch0[k]  = moments[k]->nuDyn_ch0  - reference->nuDyn_ch0;
+    dNuDyn_ch0s[k] = moments[k]->nuDyn_ch0s - reference->nuDyn_ch0s;
+    for (int iSub=0; iSub<nSubsamples; iSub++)
+      {
+      values_ch0[iSub]  = moments[k]->subsamples[iSub].nuDyn(KaonSpecies::kc, KaonSpecies::k0)
+                        - reference->subsamples[iSub].nuDyn(KaonSpecies::kc, KaonSpecies::k0);
+      values_ch0s[iSub] = moments[k]->subsamples[iSub].nuDyn(KaonSpecies::kc, KaonSpecies::k0s)
+                        - reference->subsamples[iSub].nuDyn(KaonSpecies::kc, KaonSpecies::k0s);
+      }
+    dNuDyn_ch0_err[k]  = reference->subsampleError(values_ch0);
+    dNuDyn_ch0s_err[k] = reference->subsampleError(values_ch0s);
+    }
+  }
+  
+  ////////////////////////////////////////////
+  // nuDyn and its difference to the reference
+  // (or previous) variant for every variant
+  ////////////////////////////////////////////
+  void print(ostream & os)
+  {
+  os << "----------------------------------------------------" << endl;
+  if (referenceVariant==previousVariant)
+    os << "  differences d() to the previous dccF" << endl;
+  else
+    os << "  differences d() to dccF: " << dccFractions[referenceVariant] << endl;
+  os << "  dccF    nEvents   nuDyn_ch0 +- err   d(nuDyn_ch0) +- err   nuDyn_ch0s +- err   d(nuDyn_ch0s) +- err" << endl;
+  for (int k=0; k<nVariants; k++)
+    {
+    KaonMoments * m = moments[k];
+    os << setw(6)  << dccFractions[k]
+       << setw(11) << m->nEvents
+       << "   " << m->nuDyn_ch0  << " +- " << m->nuDyn_ch0_err
+       << "   " << dNuDyn_ch0[k] << " +- " << dNuDyn_ch0_err[k]
+       << "   " << m->nuDyn_ch0s  << " +- " << m->nuDyn_ch0s_err
+       << "   " << dNuDyn_ch0s[k] << " +- " << dNuDyn_ch0s_err[k] << endl;
+    }
+  KaonStageTimers allTimers = timers;
+  for (int k=0; k<nVariants; k++) allTimers.add(variantTimers[k]);
+  allTimers.print(os);
+  }
+  
+};
+
+#endif // DccToyModel_h
@@ -0,0 +1,24 @@
+/********************************************************************
+ Compiled driver of BenchmarkDccToyModel(), see BenchmarkDccToyModel.C
+ usage: benchmarkDccToyModel [nEvents [nThreads [outputFileName]]]
+ *********************************************************************/
+
+#include <cstdlib>
+#include <TROOT.h>
+#include <TString.h>
+
+void BenchmarkDccToyModel(int nEvents, int nThreads, const TString & outputFileName);
+
+int main(int argc, char ** argv)
+{
+  int     nEvents        = 1000000;
+  int     nThreads       = 0;
+  TString outputFileName = "";
+  if (argc>1) nEvents        = atoi(argv[1]);
+  if (argc>2) nThreads       = atoi(argv[2]);
+  if (argc>3) outputFileName = argv[3];
+
+  gROOT->SetBatch(kTRUE);
+  BenchmarkDccToyModel(nEvents, nThreads, outputFileName);
+  return 0;
+}
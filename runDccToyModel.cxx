@@ -0,0 +1,39 @@
+/********************************************************************
+ Compiled driver of RunDccToyModel(), see RunDccToyModel.C
+ usage: runDccToyModel [nEvents [nThreads [relativePrecision [absolutePrecision]]]] [--headless] [--shared-base]
+ *********************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <TROOT.h>
+
+void RunDccToyModel(int nEventsRequested, int nThreads, double relativePrecision, double absolutePrecision, bool headless, bool sharedBase);
+
+int main(int argc, char ** argv)
+{
+  int    nEventsRequested  = 1000;
+  int    nThreads          = 0;
+  double relativePrecision = 0.0;
+  double absolutePrecision = 0.0;
+  bool   headless          = false;
+  bool   sharedBase        = false;
+
+  int iArg = 0;
+  for (int k=1; k<argc; k++)
+  {
+    if (strcmp(argv[k], "--headless")==0)    { headless = true;   continue; }
+    if (strcmp(argv[k], "--shared-base")==0) { sharedBase = true; continue; }
+    switch (iArg++)
+    {
+      case 0: nEventsRequested  = atoi(argv[k]); break;
+      case 1: nThreads          = atoi(argv[k]); break;
+      case 2: relativePrecision = atof(argv[k]); break;
+      case 3: absolutePrecision = atof(argv[k]); break;
+    }
+  }
+
+  // canvases are only printed to pdf files
+  gROOT->SetBatch(kTRUE);
+  RunDccToyModel(nEventsRequested, nThreads, relativePrecision, absolutePrecision, headless, sharedBase);
+  return 0;
+}